@@ -0,0 +1,65 @@
+#ifndef __BOUNDEDQUEUE_CPP
+#define __BOUNDEDQUEUE_CPP
+
+#include "BoundedQueue.h"
+
+/*
+Constructor.
+*/
+template <typename T>
+BoundedQueue<T>::BoundedQueue(std::size_t _capacity)
+{
+	capacity = _capacity > 0 ? _capacity : 1;
+	closed = false;
+}
+
+/*
+Add an item at the back, waiting while the queue is full.
+*/
+template <typename T>
+bool BoundedQueue<T>::push(const T &item)
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		cv_not_full.wait(lock, [&]{ return closed || items.size() < capacity; });
+		if (closed)
+			return false;
+		items.push_back(item);
+	}
+	cv_not_empty.notify_one();
+	return true;
+}
+
+/*
+Take the item at the front, waiting while the queue is empty.
+*/
+template <typename T>
+bool BoundedQueue<T>::pop(T &item)
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		cv_not_empty.wait(lock, [&]{ return closed || !items.empty(); });
+		if (items.empty())
+			return false;
+		item = items.front();
+		items.pop_front();
+	}
+	cv_not_full.notify_one();
+	return true;
+}
+
+/*
+Close the queue.
+*/
+template <typename T>
+void BoundedQueue<T>::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		closed = true;
+	}
+	cv_not_full.notify_all();
+	cv_not_empty.notify_all();
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef __BOUNDEDQUEUE_H
+#define __BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/*
+Blocking queue of bounded capacity between the stage threads of a pipeline: push waits while the queue is full, pop 
+waits while it is empty. After close(), push drops its item and pop returns false once the queue is drained, so that the 
+stages can exit.
+*/
+template <typename T> class BoundedQueue {
+private:
+	std::deque<T> items;
+	std::size_t capacity;
+	bool closed;
+	std::mutex mtx;
+	std::condition_variable cv_not_full;
+	std::condition_variable cv_not_empty;
+
+public:
+	BoundedQueue(std::size_t _capacity);
+
+	/*
+	Add an item at the back. Returns false if the queue is closed.
+	*/
+	bool push(const T &item);
+
+	/*
+	Take the item at the front. Returns false if the queue is closed and empty.
+	*/
+	bool pop(T &item);
+
+	/*
+	Wake up all waiting threads and refuse new items.
+	*/
+	void close();
+
+};
+
+#include "BoundedQueue.cpp"
+
+#endif
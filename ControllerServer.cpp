@@ -0,0 +1,176 @@
+#ifndef __CONTROLLERSERVER_CPP
+#define __CONTROLLERSERVER_CPP
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "ControllerServer.h"
+
+/*
+Constructor.
+*/
+template <typename ControllerT>
+ControllerServer<ControllerT>::ControllerServer(const seal::EncryptionParameters &_parms, 
+	std::shared_ptr<seal::SEALContext> _context, const seal::PublicKey &_public_key, unsigned _num_threads)
+	: parms(_parms), context(_context), public_key(_public_key), pool(_num_threads)
+{
+	error = nullptr;
+}
+
+/*
+Add a loop.
+*/
+template <typename ControllerT>
+unsigned ControllerServer<ControllerT>::add_loop(std::unique_ptr<ControllerT> controller, std::chrono::microseconds period)
+{
+	controller->getEncryption(parms, context, public_key);
+	std::unique_ptr<Loop> loop = std::make_unique<Loop>();
+	loop->controller = std::move(controller);
+	loop->period = period;
+	loop->busy = false;
+	loop->stats = {0, 0, 0, 0, 0};
+	loops.push_back(std::move(loop));
+	return loops.size() - 1;
+}
+
+/*
+Release a time step of a loop.
+*/
+template <typename ControllerT>
+bool ControllerServer<ControllerT>::submit(unsigned l, const std::vector<seal::Ciphertext> &encrypted_x, Callback on_done, 
+	std::chrono::steady_clock::time_point release)
+{
+	if (l >= loops.size())
+		throw std::invalid_argument("Unknown loop");
+	Loop &loop = *loops[l];
+	if (loop.busy.exchange(true))
+	{
+		loop.stats.overruns++;
+		return false;
+	}
+	const std::vector<seal::Ciphertext> *x = &encrypted_x;
+	pool.submit([this, l, x, on_done, release]{ run_job(l, x, on_done, release); });
+	return true;
+}
+
+/*
+Release the time steps of several loops, earliest deadline first.
+*/
+template <typename ControllerT>
+unsigned ControllerServer<ControllerT>::submit(std::vector<Request> requests, std::chrono::steady_clock::time_point release)
+{
+	std::stable_sort(requests.begin(), requests.end(), [&](const Request &a, const Request &b)
+	{
+		return loops.at(a.loop)->period < loops.at(b.loop)->period;
+	});
+	unsigned accepted = 0;
+	for (unsigned r=0; r<requests.size(); r++)
+	{
+		accepted += submit(requests[r].loop, *requests[r].encrypted_x, requests[r].on_done, release);
+	}
+	return accepted;
+}
+
+/*
+Job of a time step: evaluate the control law, record the latency against the deadline and hand over the result.
+*/
+template <typename ControllerT>
+void ControllerServer<ControllerT>::run_job(unsigned l, const std::vector<seal::Ciphertext> *encrypted_x, 
+	const Callback &on_done, std::chrono::steady_clock::time_point release)
+{
+	Loop &loop = *loops[l];
+	try
+	{
+		const std::vector<seal::Ciphertext> &encrypted_u = loop.controller->update_control(*encrypted_x);
+		std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+		double latency_us = std::chrono::duration<double, std::micro>(finish - release).count();
+		loop.stats.jobs++;
+		loop.stats.total_latency_us += latency_us;
+		loop.stats.max_latency_us = std::max(loop.stats.max_latency_us, latency_us);
+		if (finish > release + loop.period)
+			loop.stats.misses++;
+		if (on_done)
+			on_done(l, encrypted_u);
+	}
+	catch(...)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (!error)
+			error = std::current_exception();
+	}
+	loop.busy.store(false);
+}
+
+/*
+Block until all released jobs are done.
+*/
+template <typename ControllerT>
+void ControllerServer<ControllerT>::wait_idle()
+{
+	pool.wait_idle();
+	std::lock_guard<std::mutex> lock(mtx);
+	if (error)
+	{
+		std::exception_ptr e = error;
+		error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+/*
+Get the statistics of a loop.
+*/
+template <typename ControllerT>
+const LoopStats &ControllerServer<ControllerT>::get_stats(unsigned loop) const
+{
+	return loops.at(loop)->stats;
+}
+
+/*
+Get the total number of deadline misses.
+*/
+template <typename ControllerT>
+std::uint64_t ControllerServer<ControllerT>::get_total_misses() const
+{
+	std::uint64_t misses = 0;
+	for (unsigned l=0; l<loops.size(); l++)
+	{
+		misses += loops[l]->stats.misses;
+	}
+	return misses;
+}
+
+/*
+Get the number of loops.
+*/
+template <typename ControllerT>
+unsigned ControllerServer<ControllerT>::get_num_loops() const
+{
+	return loops.size();
+}
+
+/*
+Print the jobs, deadline misses, overruns and latencies of every loop.
+*/
+template <typename ControllerT>
+void ControllerServer<ControllerT>::print_report(std::ostream &stream) const
+{
+	std::uint64_t jobs = 0, misses = 0, overruns = 0;
+	stream << "/ Controller server: " << loops.size() << " loops on " << pool.get_num_threads() << " workers, " 
+		<< pool.get_steals() << " jobs stolen" << std::endl;
+	for (unsigned l=0; l<loops.size(); l++)
+	{
+		const LoopStats &stats = loops[l]->stats;
+		stream << "| loop " << l << ": period " << loops[l]->period.count() << " us, " << stats.jobs << " jobs, " 
+			<< stats.misses << " misses, " << stats.overruns << " overruns, latency mean " 
+			<< (stats.jobs ? stats.total_latency_us / stats.jobs : 0) << " us, max " << stats.max_latency_us << " us" 
+			<< std::endl;
+		jobs += stats.jobs;
+		misses += stats.misses;
+		overruns += stats.overruns;
+	}
+	stream << "| total: " << jobs << " jobs, " << misses << " deadline misses, " << overruns << " overruns" << std::endl;
+	stream << "\\" << std::endl;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef __CONTROLLERSERVER_H
+#define __CONTROLLERSERVER_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <iostream>
+#include <cstdint>
+
+#include "seal/seal.h"
+#include "WorkStealingPool.h"
+
+/*
+Deadline statistics of one loop of the server. A job misses its deadline if it finishes later than its release time plus 
+the sampling period of its loop; a submission overruns if the previous job of the same loop has not finished yet, in 
+which case it is dropped.
+*/
+struct LoopStats
+{
+	std::uint64_t jobs;
+	std::uint64_t misses;
+	std::uint64_t overruns;
+	double total_latency_us; // From release to the end of update_control.
+	double max_latency_us;
+};
+
+/*
+Server that hosts the controllers of many independent loops under one SEAL context and public key. The update_control 
+jobs of all loops are scheduled on one work-stealing pool, each with the deadline given by the sampling period of its 
+loop, and the deadline misses are recorded per loop. Each controller runs at most one job at a time, so it needs no 
+locking, and its encrypted_u buffer stays valid until the next submission of its loop.
+*/
+template <typename ControllerT> class ControllerServer {
+public:
+	typedef std::function<void(unsigned, const std::vector<seal::Ciphertext> &)> Callback;
+
+	/*
+	Request of a time step of a loop: encrypted_x has to stay valid until the job is done.
+	*/
+	struct Request
+	{
+		unsigned loop;
+		const std::vector<seal::Ciphertext> *encrypted_x;
+		Callback on_done;
+	};
+
+private:
+	struct Loop
+	{
+		std::unique_ptr<ControllerT> controller;
+		std::chrono::microseconds period;
+		std::atomic<bool> busy;
+		LoopStats stats;
+	};
+
+	seal::EncryptionParameters parms;
+	std::shared_ptr<seal::SEALContext> context;
+	seal::PublicKey public_key;
+	std::vector<std::unique_ptr<Loop>> loops;
+	std::mutex mtx;
+	std::exception_ptr error;
+	WorkStealingPool pool; // Last member, so that its workers stop before the loops are destroyed.
+
+	void run_job(unsigned l, const std::vector<seal::Ciphertext> *encrypted_x, const Callback &on_done, 
+		std::chrono::steady_clock::time_point release);
+
+public:
+	ControllerServer(const seal::EncryptionParameters &_parms, std::shared_ptr<seal::SEALContext> _context, 
+		const seal::PublicKey &_public_key, unsigned _num_threads = std::thread::hardware_concurrency());
+
+	/*
+	Add a loop with the given sampling period and return its index. The controller gets the context and public key of 
+	the server. Call before the first submission.
+	*/
+	unsigned add_loop(std::unique_ptr<ControllerT> controller, std::chrono::microseconds period);
+
+	/*
+	Release a time step of a loop: compute its control input on the pool and call on_done with it, from the worker. 
+	Returns false, and counts an overrun, if the previous time step of the loop is still running.
+	*/
+	bool submit(unsigned loop, const std::vector<seal::Ciphertext> &encrypted_x, Callback on_done, 
+		std::chrono::steady_clock::time_point release = std::chrono::steady_clock::now());
+
+	/*
+	Release the time steps of several loops at once, earliest deadline first. Returns the number of accepted requests.
+	*/
+	unsigned submit(std::vector<Request> requests, std::chrono::steady_clock::time_point release = std::chrono::steady_clock::now());
+
+	/*
+	Block until all released jobs are done. Rethrows the first error of a job.
+	*/
+	void wait_idle();
+
+	/*
+	Access the statistics of a loop, the total number of deadline misses, and print a report of all loops.
+	*/
+	const LoopStats &get_stats(unsigned loop) const;
+	std::uint64_t get_total_misses() const;
+	unsigned get_num_loops() const;
+	void print_report(std::ostream &stream) const;
+
+};
+
+#include "ControllerServer.cpp"
+
+#endif
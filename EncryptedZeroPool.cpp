@@ -0,0 +1,99 @@
+#ifndef __ENCRYPTEDZEROPOOL_CPP
+#define __ENCRYPTEDZEROPOOL_CPP
+
+#include "EncryptedZeroPool.h"
+
+using namespace std;
+using namespace seal;
+
+
+/*
+Constructor: the capacity is rounded up to a power of 2 and the producer starts filling the pool.
+*/
+EncryptedZeroPool::EncryptedZeroPool(shared_ptr<SEALContext> _context, const PublicKey &_public_key, size_t _capacity)
+	: plain_zero("0")
+{
+	size_t capacity = 1;
+	while (capacity < _capacity)
+		capacity <<= 1;
+	encryptor = make_unique<Encryptor>(_context, _public_key);
+	slots.resize(capacity);
+	mask = capacity - 1;
+	head = 0;
+	tail = 0;
+	stop = false;
+	misses = 0;
+	producer = thread(&EncryptedZeroPool::produce, this);
+}
+
+/*
+Destructor: stop the producer.
+*/
+EncryptedZeroPool::~EncryptedZeroPool()
+{
+	stop = true;
+	producer.join();
+}
+
+/*
+Loop of the producer: encrypt zeros while there is room in the ring, back off while it is full.
+*/
+void EncryptedZeroPool::produce()
+{
+	while (!stop.load(memory_order_relaxed))
+	{
+		size_t t = tail.load(memory_order_relaxed);
+		if (t - head.load(memory_order_acquire) > mask)
+		{
+			this_thread::sleep_for(chrono::microseconds(100));
+			continue;
+		}
+		encryptor->encrypt(plain_zero, slots[t & mask]);
+		tail.store(t + 1, memory_order_release);
+	}
+}
+
+/*
+Take a fresh encryption of zero. If the pool is empty, encrypt zero on the spot.
+*/
+void EncryptedZeroPool::take(Ciphertext &destination)
+{
+	size_t h = head.load(memory_order_relaxed);
+	if (h == tail.load(memory_order_acquire))
+	{
+		misses.fetch_add(1, memory_order_relaxed);
+		INSTRUMENT_COUNT(Counter::encrypt, 1);
+		encryptor->encrypt(plain_zero, destination);
+		return;
+	}
+	swap(destination, slots[h & mask]);
+	head.store(h + 1, memory_order_release);
+}
+
+/*
+Take a fresh encryption of zero and add a plaintext to it.
+*/
+void EncryptedZeroPool::encrypt(const Plaintext &plain, Ciphertext &destination, const unique_ptr<Evaluator> &evaluator)
+{
+	take(destination);
+	evaluator->add_plain_inplace(destination, plain);
+	INSTRUMENT_COUNT(Counter::add, 1);
+}
+
+/*
+Get the number of ready encryptions of zero.
+*/
+size_t EncryptedZeroPool::get_size() const
+{
+	return tail.load(memory_order_acquire) - head.load(memory_order_acquire);
+}
+
+/*
+Get the number of takes that found the pool empty.
+*/
+size_t EncryptedZeroPool::get_misses() const
+{
+	return misses.load(memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __ENCRYPTEDZEROPOOL_H
+#define __ENCRYPTEDZEROPOOL_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+#include "seal/seal.h"
+#include "Instrumentation.h"
+
+/*
+Bounded pool of fresh encryptions of zero, filled by a background ("offline") thread during idle time. The online step takes 
+an encryption of zero from the pool instead of encrypting, and obtains an encryption of a plaintext p as zero + p. The pool 
+is a lock-free single-producer/single-consumer ring: the producer is the background thread and the consumer is the owner of 
+the pool. Every encryption of zero is handed out only once.
+*/
+class EncryptedZeroPool {
+private:
+	std::unique_ptr<seal::Encryptor> encryptor;
+	seal::Plaintext plain_zero;
+	std::vector<seal::Ciphertext> slots;
+	std::size_t mask;
+	std::atomic<std::size_t> head; // Next slot to take, written by the consumer.
+	std::atomic<std::size_t> tail; // Next slot to fill, written by the producer.
+	std::atomic<bool> stop;
+	std::atomic<std::size_t> misses; // Number of takes that found the pool empty.
+	std::thread producer;
+
+	void produce();
+
+public:
+	EncryptedZeroPool(std::shared_ptr<seal::SEALContext> _context, const seal::PublicKey &_public_key, std::size_t _capacity);
+	virtual ~EncryptedZeroPool();
+
+	/*
+	Take a fresh encryption of zero. If the pool is empty, encrypt zero on the spot. The previous contents of destination 
+	are handed to the producer, so that the steady state does not allocate.
+	*/
+	void take(seal::Ciphertext &destination);
+
+	/*
+	Take a fresh encryption of zero and add a plaintext to it, which gives a fresh encryption of the plaintext.
+	*/
+	void encrypt(const seal::Plaintext &plain, seal::Ciphertext &destination, const std::unique_ptr<seal::Evaluator> &evaluator);
+
+	/*
+	Access the number of ready encryptions and the number of takes that had to encrypt online.
+	*/
+	std::size_t get_size() const;
+	std::size_t get_misses() const;
+
+};
+
+#include "EncryptedZeroPool.cpp"
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef __FIXEDMATRIX_CPP
+#define __FIXEDMATRIX_CPP
+
+#include "FixedMatrix.h"
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+
+/*
+Compile-time unrolling: call f(integral_constant<I>) for I = 0, ..., N-1, or sum the results of these calls.
+*/
+namespace fixed_matrix_detail {
+
+template <typename F, std::size_t... I>
+inline void unroll(F&& f, std::index_sequence<I...>)
+{
+	(f(std::integral_constant<std::size_t, I>()), ...);
+}
+
+template <std::size_t N, typename F>
+inline void unroll(F&& f)
+{
+	unroll(std::forward<F>(f), std::make_index_sequence<N>());
+}
+
+template <typename T, typename F, std::size_t... I>
+inline T unroll_sum(F&& f, std::index_sequence<I...>)
+{
+	return (T(0) + ... + f(std::integral_constant<std::size_t, I>()));
+}
+
+template <typename T, std::size_t N, typename F>
+inline T unroll_sum(F&& f)
+{
+	return unroll_sum<T>(std::forward<F>(f), std::make_index_sequence<N>());
+}
+
+}
+
+
+/*
+Empty Constructor: all elements are zero.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedMatrix<T, R, C>::FixedMatrix()
+{
+	mat.fill(T(0));
+}
+
+/*
+Parameter Constructor.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedMatrix<T, R, C>::FixedMatrix(const T& _initial)
+{
+	mat.fill(_initial);
+}
+
+/*
+Constructor with elements, given row-major.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedMatrix<T, R, C>::FixedMatrix(const T _values[])
+{
+	std::copy(_values, _values + R * C, mat.begin());
+}
+
+/*
+Addition of two matrices.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedMatrix<T, R, C> FixedMatrix<T, R, C>::operator+(const FixedMatrix<T, R, C>& rhs) const
+{
+	FixedMatrix<T, R, C> result = *this;
+	result += rhs;
+	return result;
+}
+
+/*
+Cumulative addition of this matrix and another.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedMatrix<T, R, C>& FixedMatrix<T, R, C>::operator+=(const FixedMatrix<T, R, C>& rhs)
+{
+	fixed_matrix_detail::unroll<R * C>([&](auto k) { mat[k] += rhs.mat[k]; });
+	return *this;
+}
+
+/*
+Subtraction of two matrices.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedMatrix<T, R, C> FixedMatrix<T, R, C>::operator-(const FixedMatrix<T, R, C>& rhs) const
+{
+	FixedMatrix<T, R, C> result = *this;
+	result -= rhs;
+	return result;
+}
+
+/*
+Cumulative subtraction of this matrix and another.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedMatrix<T, R, C>& FixedMatrix<T, R, C>::operator-=(const FixedMatrix<T, R, C>& rhs)
+{
+	fixed_matrix_detail::unroll<R * C>([&](auto k) { mat[k] -= rhs.mat[k]; });
+	return *this;
+}
+
+/*
+Left multiplication of this matrix and another.
+*/
+template <typename T, unsigned R, unsigned C>
+template <unsigned C2>
+FixedMatrix<T, R, C2> FixedMatrix<T, R, C>::operator*(const FixedMatrix<T, C, C2>& rhs) const
+{
+	FixedMatrix<T, R, C2> result;
+	fixed_matrix_detail::unroll<R * C2>([&](auto ij)
+	{
+		constexpr unsigned i = decltype(ij)::value / C2;
+		constexpr unsigned j = decltype(ij)::value % C2;
+		result(i, j) = fixed_matrix_detail::unroll_sum<T, C>([&](auto k) { return mat[i * C + k] * rhs(k, j); });
+	});
+	return result;
+}
+
+/*
+Calculate a transpose of this matrix.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedMatrix<T, C, R> FixedMatrix<T, R, C>::transpose() const
+{
+	FixedMatrix<T, C, R> result;
+	fixed_matrix_detail::unroll<R * C>([&](auto ij)
+	{
+		constexpr unsigned i = decltype(ij)::value / C;
+		constexpr unsigned j = decltype(ij)::value % C;
+		result(j, i) = mat[ij];
+	});
+	return result;
+}
+
+/*
+Dot product of a row with a vector.
+*/
+template <typename T, unsigned R, unsigned C>
+template <std::size_t... J>
+T FixedMatrix<T, R, C>::row_dot(unsigned i, const FixedVector<T, C>& rhs, std::index_sequence<J...>) const
+{
+	return (T(0) + ... + (mat[i * C + J] * rhs[J]));
+}
+
+/*
+Products of all rows with a vector.
+*/
+template <typename T, unsigned R, unsigned C>
+template <std::size_t... I>
+FixedVector<T, R> FixedMatrix<T, R, C>::mult_vector(const FixedVector<T, C>& rhs, std::index_sequence<I...>) const
+{
+	return FixedVector<T, R>{{ row_dot(I, rhs, std::make_index_sequence<C>())... }};
+}
+
+/*
+Multiply a matrix with a vector.
+*/
+template <typename T, unsigned R, unsigned C>
+FixedVector<T, R> FixedMatrix<T, R, C>::operator*(const FixedVector<T, C>& rhs) const
+{
+	return mult_vector(rhs, std::make_index_sequence<R>());
+}
+
+/*
+Access the individual elements.
+*/
+template <typename T, unsigned R, unsigned C>
+T& FixedMatrix<T, R, C>::operator()(const unsigned& row, const unsigned& col)
+{
+	return mat[row * C + col];
+}
+
+/*
+Access the individual elements (const).
+*/
+template <typename T, unsigned R, unsigned C>
+const T& FixedMatrix<T, R, C>::operator()(const unsigned& row, const unsigned& col) const
+{
+	return mat[row * C + col];
+}
+
+/*
+Print matrix.
+*/
+template <typename T, unsigned R, unsigned C>
+void FixedMatrix<T, R, C>::print() const
+{
+	for (unsigned i=0; i<R; i++)
+	{
+		for (unsigned j=0; j<C; j++)
+		{
+			std::cout << mat[i * C + j] << " ";
+		}
+	std::cout << std::endl;
+	}
+}
+
+/*
+Write matrix on one line.
+*/
+template <typename T, unsigned R, unsigned C>
+std::ostream& operator<<(std::ostream& stream, const FixedMatrix<T, R, C>& matrix)
+{
+	for (unsigned i=0; i<R; i++)
+	{
+		for (unsigned j=0; j<C; j++)
+		{
+			stream << matrix(i, j) << " ";
+		}
+		if (i + 1 < R)
+			stream << "; ";
+	}
+	return stream;
+}
+
+/*
+Copy to a heap-backed matrix.
+*/
+template <typename T, unsigned R, unsigned C>
+Matrix<T> FixedMatrix<T, R, C>::to_matrix() const
+{
+	return Matrix<T>(R, C, mat.data());
+}
+
+/*
+Addition of two vectors of compile-time size.
+*/
+template <typename T, std::size_t N>
+FixedVector<T, N> operator+(const std::array<T, N>& lhs, const std::array<T, N>& rhs)
+{
+	FixedVector<T, N> result;
+	fixed_matrix_detail::unroll<N>([&](auto k) { result[k] = lhs[k] + rhs[k]; });
+	return result;
+}
+
+/*
+View a std::vector as a std::vector.
+*/
+template <typename T>
+const std::vector<T>& as_std_vector(const std::vector<T>& v, std::vector<T>& buffer)
+{
+	return v;
+}
+
+/*
+View a fixed-size vector as a std::vector, by a copy into the buffer.
+*/
+template <typename T, std::size_t N>
+const std::vector<T>& as_std_vector(const std::array<T, N>& v, std::vector<T>& buffer)
+{
+	buffer.assign(v.begin(), v.end());
+	return buffer;
+}
+
+/*
+Copy a std::vector into a std::vector.
+*/
+template <typename T>
+void assign_vector(std::vector<T>& destination, const std::vector<T>& v)
+{
+	destination = v;
+}
+
+/*
+Copy a std::vector into a fixed-size vector.
+*/
+template <typename T, std::size_t N>
+void assign_vector(std::array<T, N>& destination, const std::vector<T>& v)
+{
+	std::copy(v.begin(), v.begin() + std::min(N, v.size()), destination.begin());
+}
+
+/*
+View a Matrix as a Matrix.
+*/
+template <typename T>
+const Matrix<T>& as_matrix(const Matrix<T>& m)
+{
+	return m;
+}
+
+/*
+View a FixedMatrix as a Matrix, by a copy.
+*/
+template <typename T, unsigned R, unsigned C>
+Matrix<T> as_matrix(const FixedMatrix<T, R, C>& m)
+{
+	return m.to_matrix();
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef __FIXEDMATRIX_H
+#define __FIXEDMATRIX_H
+
+#include <array>
+#include <vector>
+#include <utility>
+
+#include "Matrix.h"
+
+/*
+Vector of compile-time size.
+*/
+template <typename T, unsigned N> using FixedVector = std::array<T, N>;
+
+/*
+Matrix of compile-time size, for small plants. The elements are stored row-major in a std::array, so there is no heap
+allocation, and multiplication and addition are fully unrolled at compile time. Operands of incompatible dimensions do not
+compile.
+*/
+template <typename T, unsigned R, unsigned C> class FixedMatrix {
+private:
+	std::array<T, R * C> mat;
+
+	template <std::size_t... J>
+	T row_dot(unsigned i, const FixedVector<T, C>& rhs, std::index_sequence<J...>) const;
+	template <std::size_t... I>
+	FixedVector<T, R> mult_vector(const FixedVector<T, C>& rhs, std::index_sequence<I...>) const;
+
+public:
+	typedef FixedVector<T, C> input_vector; // Type of the vectors that the matrix multiplies.
+	typedef FixedVector<T, R> output_vector; // Type of the products with a vector.
+
+	static constexpr unsigned rows = R;
+	static constexpr unsigned cols = C;
+
+	FixedMatrix();
+	FixedMatrix(const T& _initial);
+	FixedMatrix(const T _values[]);
+
+	/*
+	Matrix mathematical operations.
+	*/
+	FixedMatrix<T, R, C> operator+(const FixedMatrix<T, R, C>& rhs) const;
+	FixedMatrix<T, R, C>& operator+=(const FixedMatrix<T, R, C>& rhs);
+	FixedMatrix<T, R, C> operator-(const FixedMatrix<T, R, C>& rhs) const;
+	FixedMatrix<T, R, C>& operator-=(const FixedMatrix<T, R, C>& rhs);
+	template <unsigned C2>
+	FixedMatrix<T, R, C2> operator*(const FixedMatrix<T, C, C2>& rhs) const;
+	FixedMatrix<T, C, R> transpose() const;
+
+	/*
+	Matrix/vector operations.
+	*/
+	FixedVector<T, R> operator*(const FixedVector<T, C>& rhs) const;
+
+	/*
+	Access the individual elements.
+	*/
+	T& operator()(const unsigned& row, const unsigned& col);
+	const T& operator()(const unsigned& row, const unsigned& col) const;
+
+	/*
+	Access the row and column sizes.
+	*/
+	constexpr unsigned get_rows() const { return R; }
+	constexpr unsigned get_cols() const { return C; }
+	void print() const;
+
+	/*
+	Copy to a heap-backed matrix, e.g., for the encoders.
+	*/
+	Matrix<T> to_matrix() const;
+
+};
+
+/*
+Write a matrix on one line, with the rows separated by semicolons, e.g., for a log record.
+*/
+template <typename T, unsigned R, unsigned C>
+std::ostream& operator<<(std::ostream& stream, const FixedMatrix<T, R, C>& matrix);
+
+/*
+Addition of two vectors of compile-time size.
+*/
+template <typename T, std::size_t N>
+FixedVector<T, N> operator+(const std::array<T, N>& lhs, const std::array<T, N>& rhs);
+
+/*
+View a state or input vector as a std::vector for the encoders: a std::vector is passed through, a fixed-size vector is
+copied into the given buffer, which keeps its allocation across calls.
+*/
+template <typename T>
+const std::vector<T>& as_std_vector(const std::vector<T>& v, std::vector<T>& buffer);
+template <typename T, std::size_t N>
+const std::vector<T>& as_std_vector(const std::array<T, N>& v, std::vector<T>& buffer);
+
+/*
+Copy a decoded std::vector into a state or input vector.
+*/
+template <typename T>
+void assign_vector(std::vector<T>& destination, const std::vector<T>& v);
+template <typename T, std::size_t N>
+void assign_vector(std::array<T, N>& destination, const std::vector<T>& v);
+
+/*
+View a gain matrix as a heap-backed Matrix for the encoders.
+*/
+template <typename T>
+const Matrix<T>& as_matrix(const Matrix<T>& m);
+template <typename T, unsigned R, unsigned C>
+Matrix<T> as_matrix(const FixedMatrix<T, R, C>& m);
+
+#include "FixedMatrix.cpp"
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef __INSTRUMENTATION_CPP
+#define __INSTRUMENTATION_CPP
+
+#include "Instrumentation.h"
+#include <fstream>
+#include <algorithm>
+
+#include "seal/seal.h"
+
+using namespace std;
+
+const char *phase_labels[num_phases_] = {"encode", "encrypt", "evaluate", "decrypt", "decode", "update_state"};
+const char *counter_labels[num_counters_] = {"multiply", "multiply_plain", "add", "relinearize", "rotate", "encrypt", 
+	"decrypt", "pool_bytes"};
+
+
+/*
+Constructor: all timers and counters at zero.
+*/
+Instrumentation::Instrumentation()
+{
+	reset();
+}
+
+/*
+Get the process-wide instance.
+*/
+Instrumentation &Instrumentation::get()
+{
+	static Instrumentation instance;
+	return instance;
+}
+
+/*
+Add a duration to a phase of the current step.
+*/
+void Instrumentation::add_time(Phase phase, uint64_t ns)
+{
+	phase_ns[static_cast<int>(phase)].fetch_add(ns, memory_order_relaxed);
+}
+
+/*
+Add to a counter of the current step.
+*/
+void Instrumentation::add_count(Counter counter, uint64_t amount)
+{
+	counters[static_cast<int>(counter)].fetch_add(amount, memory_order_relaxed);
+}
+
+/*
+Close the current step: store its record and start a new one.
+*/
+void Instrumentation::end_step()
+{
+	lock_guard<mutex> lock(mtx);
+	size_t bytes = seal::MemoryManager::GetPool().alloc_byte_count();
+	counters[static_cast<int>(Counter::pool_bytes)].fetch_add(bytes - pool_bytes, memory_order_relaxed);
+	pool_bytes = bytes;
+
+	StepRecord record;
+	for (int p=0; p<num_phases_; p++)
+	{
+		record.phase_ns[p] = phase_ns[p].exchange(0, memory_order_relaxed);
+	}
+	for (int c=0; c<num_counters_; c++)
+	{
+		record.counters[c] = counters[c].exchange(0, memory_order_relaxed);
+	}
+	steps.push_back(record);
+}
+
+/*
+Discard all records.
+*/
+void Instrumentation::reset()
+{
+	lock_guard<mutex> lock(mtx);
+	for (int p=0; p<num_phases_; p++)
+	{
+		phase_ns[p] = 0;
+	}
+	for (int c=0; c<num_counters_; c++)
+	{
+		counters[c] = 0;
+	}
+	steps.clear();
+	pool_bytes = seal::MemoryManager::GetPool().alloc_byte_count();
+}
+
+/*
+Get the records of the closed steps.
+*/
+const vector<StepRecord> &Instrumentation::get_steps() const
+{
+	return steps;
+}
+
+/*
+Print the mean, median, 99th percentile and maximum of every phase, and the mean of every counter per step.
+*/
+void Instrumentation::print_summary(ostream &stream)
+{
+	lock_guard<mutex> lock(mtx);
+	stream << "/ Instrumentation summary over " << steps.size() << " steps (ns):" << endl;
+	if (steps.empty())
+		return;
+	for (int p=0; p<num_phases_; p++)
+	{
+		vector<uint64_t> samples(steps.size());
+		uint64_t total = 0;
+		for (unsigned k=0; k<steps.size(); k++)
+		{
+			samples[k] = steps[k].phase_ns[p];
+			total += samples[k];
+		}
+		sort(samples.begin(), samples.end());
+		stream << "| " << phase_labels[p] << ": mean " << total / steps.size() 
+			<< ", p50 " << samples[(samples.size() - 1) / 2] 
+			<< ", p99 " << samples[(samples.size() - 1) * 99 / 100] 
+			<< ", max " << samples.back() << endl;
+	}
+	for (int c=0; c<num_counters_; c++)
+	{
+		uint64_t total = 0;
+		for (unsigned k=0; k<steps.size(); k++)
+		{
+			total += steps[k].counters[c];
+		}
+		stream << "| " << counter_labels[c] << " per step: " << static_cast<double>(total) / steps.size() << endl;
+	}
+	stream << "\\" << endl;
+}
+
+/*
+Write the records as CSV, one row per step.
+*/
+void Instrumentation::write_trace(const string &path)
+{
+	lock_guard<mutex> lock(mtx);
+	ofstream file(path);
+	file << "step";
+	for (int p=0; p<num_phases_; p++)
+	{
+		file << "," << phase_labels[p] << "_ns";
+	}
+	for (int c=0; c<num_counters_; c++)
+	{
+		file << "," << counter_labels[c];
+	}
+	file << "\n";
+	for (unsigned k=0; k<steps.size(); k++)
+	{
+		file << k;
+		for (int p=0; p<num_phases_; p++)
+		{
+			file << "," << steps[k].phase_ns[p];
+		}
+		for (int c=0; c<num_counters_; c++)
+		{
+			file << "," << steps[k].counters[c];
+		}
+		file << "\n";
+	}
+}
+
+/*
+Constructor: start the timer.
+*/
+ScopedPhaseTimer::ScopedPhaseTimer(Phase _phase)
+{
+	phase = _phase;
+	start = chrono::steady_clock::now();
+}
+
+/*
+Destructor: add the elapsed time to the phase.
+*/
+ScopedPhaseTimer::~ScopedPhaseTimer()
+{
+	chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+	Instrumentation::get().add_time(phase, elapsed.count());
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef __INSTRUMENTATION_H
+#define __INSTRUMENTATION_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+/*
+Phases of a control step that are timed, and operations that are counted.
+*/
+enum class Phase { encode, encrypt, evaluate, decrypt, decode, update_state, num_phases };
+enum class Counter { multiply, multiply_plain, add, relinearize, rotate, encrypt, decrypt, pool_bytes, num_counters };
+
+const int num_phases_ = static_cast<int>(Phase::num_phases);
+const int num_counters_ = static_cast<int>(Counter::num_counters);
+
+/*
+Timings (in nanoseconds) and counters of one control step.
+*/
+struct StepRecord
+{
+	std::uint64_t phase_ns[num_phases_];
+	std::uint64_t counters[num_counters_];
+};
+
+/*
+Process-wide record of the per-step phase timings and operation counters. The timers and counters are atomic, so that
+the workers of a thread pool can record into them. A step is closed with end_step(), which also records the bytes that
+the global SEAL memory pool allocated during the step.
+*/
+class Instrumentation {
+private:
+	std::atomic<std::uint64_t> phase_ns[num_phases_];
+	std::atomic<std::uint64_t> counters[num_counters_];
+	std::vector<StepRecord> steps;
+	std::size_t pool_bytes;
+	std::mutex mtx;
+
+	Instrumentation();
+
+public:
+	static Instrumentation &get();
+
+	void add_time(Phase phase, std::uint64_t ns);
+	void add_count(Counter counter, std::uint64_t amount);
+	void end_step();
+	void reset();
+
+	/*
+	Export the records: a summary with the mean and percentiles of every phase and the mean of every counter per step, or
+	a CSV trace with one row per step.
+	*/
+	const std::vector<StepRecord> &get_steps() const;
+	void print_summary(std::ostream &stream);
+	void write_trace(const std::string &path);
+
+};
+
+/*
+Add the time between construction and destruction to a phase.
+*/
+class ScopedPhaseTimer {
+private:
+	Phase phase;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	ScopedPhaseTimer(Phase _phase);
+	~ScopedPhaseTimer();
+
+};
+
+/*
+The instrumentation is compiled out unless ENABLE_INSTRUMENTATION is defined, in which case the macros below time the rest
+of the enclosing scope, count operations and close a step.
+*/
+#ifdef ENABLE_INSTRUMENTATION
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+#define INSTRUMENT_PHASE(phase) ScopedPhaseTimer INSTRUMENT_CONCAT(instrument_timer_, __LINE__)(phase)
+#define INSTRUMENT_COUNT(counter, amount) Instrumentation::get().add_count(counter, amount)
+#define INSTRUMENT_END_STEP() Instrumentation::get().end_step()
+#else
+#define INSTRUMENT_PHASE(phase)
+#define INSTRUMENT_COUNT(counter, amount)
+#define INSTRUMENT_END_STEP()
+#endif
+
+#include "Instrumentation.cpp"
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef __KEYCACHE_CPP
+#define __KEYCACHE_CPP
+
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "KeyCache.h"
+
+using namespace std;
+
+const uint32_t cache_magic = 0x434b4345; // "ECKC"
+const uint16_t cache_version = 1;
+const size_t cache_header_size = 24;
+
+
+/*
+64-bit FNV-1a hash of a buffer.
+*/
+uint64_t fnv1a_64(const char *data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/*
+Constructor: empty cache.
+*/
+KeyCache::KeyCache()
+	: mapping(nullptr), mapping_size(0)
+{
+}
+
+/*
+Constructor: map a cache file, check it and index its entries.
+*/
+KeyCache::KeyCache(const string &path)
+	: mapping(nullptr), mapping_size(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw runtime_error("Cannot open " + path + ": " + strerror(errno));
+	struct stat info;
+	if (fstat(fd, &info) < 0 || info.st_size < static_cast<off_t>(cache_header_size))
+	{
+		close(fd);
+		throw runtime_error("Truncated cache file " + path);
+	}
+	mapping_size = info.st_size;
+	void *address = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+		throw runtime_error("Cannot map " + path + ": " + strerror(errno));
+	mapping = static_cast<char *>(address);
+
+	try
+	{
+		if (get_le(mapping, 4) != cache_magic || get_le(mapping + 4, 2) != cache_version)
+			throw runtime_error("Not a cache file of this version: " + path);
+		const uint64_t count = get_le(mapping + 6, 2);
+		const uint64_t body_bytes = get_le(mapping + 8, 8);
+		if (body_bytes != mapping_size - cache_header_size)
+			throw runtime_error("Truncated cache file " + path);
+		const char *body = mapping + cache_header_size;
+		if (fnv1a_64(body, body_bytes) != get_le(mapping + 16, 8))
+			throw runtime_error("Checksum mismatch in cache file " + path);
+		size_t offset = 0;
+		for (uint64_t e = 0; e < count; e++)
+		{
+			if (body_bytes - offset < 2)
+				throw runtime_error("Truncated cache entry in " + path);
+			const size_t name_bytes = get_le(body + offset, 2);
+			offset += 2;
+			if (body_bytes - offset < name_bytes + 8)
+				throw runtime_error("Truncated cache entry in " + path);
+			string name(body + offset, name_bytes);
+			offset += name_bytes;
+			const uint64_t message_bytes = get_le(body + offset, 8);
+			offset += 8;
+			if (body_bytes - offset < message_bytes)
+				throw runtime_error("Truncated cache entry in " + path);
+			entries[name] = string_view(body + offset, message_bytes);
+			offset += message_bytes;
+		}
+	}
+	catch (...)
+	{
+		munmap(mapping, mapping_size);
+		throw;
+	}
+}
+
+/*
+Destructor: unmap the file.
+*/
+KeyCache::~KeyCache()
+{
+	if (mapping)
+		munmap(mapping, mapping_size);
+}
+
+void KeyCache::put(const string &name, string message)
+{
+	if (name.size() > 0xffff)
+		throw invalid_argument("Cache entry name too long");
+	owned[name] = move(message);
+	entries[name] = owned[name];
+}
+
+bool KeyCache::contains(const string &name) const
+{
+	return entries.count(name) > 0;
+}
+
+string_view KeyCache::get(const string &name) const
+{
+	auto entry = entries.find(name);
+	if (entry == entries.end())
+		throw runtime_error("No cache entry " + name);
+	return entry->second;
+}
+
+/*
+Write the cache to a temporary file, sync it and rename it over the destination.
+*/
+void KeyCache::save(const string &path) const
+{
+	string body;
+	for (const auto &entry : entries)
+	{
+		char size_field[8];
+		put_le(size_field, entry.first.size(), 2);
+		body.append(size_field, 2);
+		body.append(entry.first);
+		put_le(size_field, entry.second.size(), 8);
+		body.append(size_field, 8);
+		body.append(entry.second.data(), entry.second.size());
+	}
+	char header[cache_header_size];
+	put_le(header, cache_magic, 4);
+	put_le(header + 4, cache_version, 2);
+	put_le(header + 6, entries.size(), 2);
+	put_le(header + 8, body.size(), 8);
+	put_le(header + 16, fnv1a_64(body.data(), body.size()), 8);
+
+	const string temporary = path + ".tmp";
+	int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+		throw runtime_error("Cannot create " + temporary + ": " + strerror(errno));
+	bool written = true;
+	for (const string_view &part : {string_view(header, cache_header_size), string_view(body)})
+	{
+		size_t offset = 0;
+		while (written && offset < part.size())
+		{
+			ssize_t result = write(fd, part.data() + offset, part.size() - offset);
+			if (result < 0 && errno == EINTR)
+				continue;
+			written = (result > 0);
+			offset += written ? result : 0;
+		}
+	}
+	written = written && fsync(fd) == 0;
+	close(fd);
+	if (!written || rename(temporary.c_str(), path.c_str()) < 0)
+	{
+		unlink(temporary.c_str());
+		throw runtime_error("Cannot write " + path + ": " + strerror(errno));
+	}
+}
+
+#endif
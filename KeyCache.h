@@ -0,0 +1,65 @@
+#ifndef __KEYCACHE_H
+#define __KEYCACHE_H
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "Serialization.h"
+
+/*
+On-disk cache of named wire messages (see Serialization.h), e.g., the encryption parameters, the keys and the encrypted 
+gain, so that a restart loads them instead of generating them. The file is
+
+	magic (4 bytes) | version (2 bytes) | count (2 bytes) | body bytes (8 bytes) | checksum (8 bytes) | body
+
+where the body is a sequence of entries, name length (2 bytes) | name | message bytes (8 bytes) | message, all 
+little-endian, and the checksum is the 64-bit FNV-1a hash of the body. The file is memory-mapped and checked on opening, 
+and the messages are read in place. Each message is further checked by its deserialize function, and the keys against 
+the context. The cache holds the secret key, so it is written with owner-only permissions.
+*/
+class KeyCache {
+private:
+	char *mapping;
+	std::size_t mapping_size;
+	std::map<std::string, std::string_view> entries; // Views of the mapping or of the owned messages.
+	std::map<std::string, std::string> owned; // Messages added with put.
+
+public:
+	/*
+	Empty cache, to be filled with put and written with save.
+	*/
+	KeyCache();
+
+	/*
+	Map a cache file and check its header and checksum. Throws runtime_error if the file does not exist or is corrupt.
+	*/
+	explicit KeyCache(const std::string &path);
+	KeyCache(const KeyCache &) = delete;
+	KeyCache &operator=(const KeyCache &) = delete;
+	virtual ~KeyCache();
+
+	/*
+	Add or replace an entry, and access an entry. get throws runtime_error if there is no entry with the name; the view is 
+	valid as long as the cache.
+	*/
+	void put(const std::string &name, std::string message);
+	bool contains(const std::string &name) const;
+	std::string_view get(const std::string &name) const;
+
+	/*
+	Write the cache to a file, through a temporary file that replaces it atomically once it is synced.
+	*/
+	void save(const std::string &path) const;
+
+};
+
+/*
+64-bit FNV-1a hash of a buffer.
+*/
+std::uint64_t fnv1a_64(const char *data, std::size_t size);
+
+#include "KeyCache.cpp"
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef __LOGGER_CPP
+#define __LOGGER_CPP
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Logger.h"
+
+using namespace std;
+
+const char *event_labels[static_cast<int>(LogEvent::num_events)] = {"x", "u", "Noise budget (bits) in encrypted_u", "x_c", "x_hat - x"};
+const uint8_t log_kind_text = 0, log_kind_int = 1, log_kind_double = 2;
+
+
+/*
+Constructor: a ring of capacity records, rounded up to a power of 2, and the drain thread.
+*/
+Logger::Logger(size_t _capacity)
+{
+	capacity = 1;
+	while (capacity < _capacity)
+		capacity <<= 1;
+	slots = make_unique<Slot[]>(capacity);
+	for (uint64_t i = 0; i < capacity; i++)
+		slots[i].sequence.store(i, memory_order_relaxed);
+	head = 0;
+	tail = 0;
+	drained = 0;
+	dropped = 0;
+	level = static_cast<int>(LogLevel::info);
+	stop = false;
+	start = chrono::steady_clock::now();
+	sink = &cout;
+	drain_thread = thread(&Logger::drain, this);
+}
+
+/*
+Get the process-wide instance.
+*/
+Logger &Logger::get()
+{
+	static Logger instance(4096);
+	return instance;
+}
+
+/*
+Destructor: write the records left in the ring and stop the drain thread.
+*/
+Logger::~Logger()
+{
+	stop.store(true, memory_order_release);
+	drain_thread.join();
+	if (dropped > 0)
+		*sink << dropped << " log records dropped because the ring was full" << endl;
+	sink->flush();
+}
+
+void Logger::set_level(LogLevel _level)
+{
+	level.store(static_cast<int>(_level), memory_order_relaxed);
+}
+
+void Logger::set_sink(ostream &stream)
+{
+	lock_guard<mutex> lock(output_mtx);
+	sink->flush();
+	sink = &stream;
+}
+
+void Logger::set_trace_file(const string &path)
+{
+	lock_guard<mutex> lock(output_mtx);
+	if (trace_file.is_open())
+		trace_file.close();
+	trace_file.open(path, ios::binary | ios::trunc);
+	if (!trace_file)
+		throw runtime_error("Cannot open the trace file " + path);
+}
+
+/*
+Claim the next slot of the ring and fill the header of its record. Returns nullptr, and counts a dropped record, if the
+ring is full.
+*/
+LogRecord *Logger::claim(LogLevel _level, uint64_t &position)
+{
+	position = head.load(memory_order_relaxed);
+	for (;;)
+	{
+		Slot &slot = slots[position & (capacity - 1)];
+		int64_t difference = static_cast<int64_t>(slot.sequence.load(memory_order_acquire))
+			- static_cast<int64_t>(position);
+		if (difference == 0)
+		{
+			if (head.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+			{
+				slot.record.time_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+				slot.record.level = _level;
+				return &slot.record;
+			}
+		}
+		else if (difference < 0)
+		{
+			dropped.fetch_add(1, memory_order_relaxed);
+			return nullptr;
+		}
+		else
+			position = head.load(memory_order_relaxed);
+	}
+}
+
+/*
+Hand a filled record over to the drain thread.
+*/
+void Logger::publish(uint64_t position)
+{
+	slots[position & (capacity - 1)].sequence.store(position + 1, memory_order_release);
+}
+
+bool Logger::log_text(LogLevel _level, const char *text, size_t size)
+{
+	uint64_t position;
+	LogRecord *record = claim(_level, position);
+	if (!record)
+		return false;
+	record->kind = log_kind_text;
+	record->event = 0;
+	record->step = 0;
+	record->size = min(size, log_payload_bytes);
+	record->count = record->size;
+	memcpy(record->payload, text, record->size);
+	publish(position);
+	return true;
+}
+
+template <typename T>
+bool Logger::log_raw(LogLevel _level, LogEvent event, uint32_t step, uint8_t kind, const vector<T> &values)
+{
+	uint64_t position;
+	LogRecord *record = claim(_level, position);
+	if (!record)
+		return false;
+	record->kind = kind;
+	record->event = static_cast<uint16_t>(event);
+	record->step = step;
+	record->size = min(values.size(), log_payload_bytes / sizeof(T)) * sizeof(T);
+	record->count = values.size();
+	memcpy(record->payload, values.data(), record->size);
+	publish(position);
+	return true;
+}
+
+bool Logger::log_values(LogLevel _level, LogEvent event, uint32_t step, const vector<int> &values)
+{
+	return log_raw(_level, event, step, log_kind_int, values);
+}
+
+bool Logger::log_values(LogLevel _level, LogEvent event, uint32_t step, const vector<double> &values)
+{
+	return log_raw(_level, event, step, log_kind_double, values);
+}
+
+/*
+Drain thread: write the records in the order of the ring, and flush the outputs whenever the ring runs empty.
+*/
+void Logger::drain()
+{
+	bool idle = true;
+	for (;;)
+	{
+		Slot &slot = slots[tail & (capacity - 1)];
+		if (slot.sequence.load(memory_order_acquire) == tail + 1)
+		{
+			{
+				lock_guard<mutex> lock(output_mtx);
+				write(slot.record);
+			}
+			slot.sequence.store(tail + capacity, memory_order_release);
+			tail++;
+			drained.store(tail, memory_order_release);
+			idle = false;
+			continue;
+		}
+		if (!idle)
+		{
+			lock_guard<mutex> lock(output_mtx);
+			sink->flush();
+			if (trace_file.is_open())
+				trace_file.flush();
+			idle = true;
+		}
+		if (stop.load(memory_order_acquire) && tail == head.load(memory_order_acquire))
+			break;
+		this_thread::sleep_for(chrono::microseconds(500));
+	}
+}
+
+/*
+Render a record to the sink, or write a binary record to the trace file.
+*/
+void Logger::write(const LogRecord &record)
+{
+	if (record.kind == log_kind_text)
+	{
+		if (record.level == LogLevel::warn)
+			*sink << "warning: ";
+		else if (record.level == LogLevel::error)
+			*sink << "error: ";
+		sink->write(record.payload, record.size);
+		sink->put('\n');
+		return;
+	}
+	if (trace_file.is_open())
+	{
+		trace_file.write(reinterpret_cast<const char *>(&record), log_header_bytes + record.size);
+		return;
+	}
+	*sink << event_labels[record.event] << "[" << record.step << "]: ";
+	if (record.kind == log_kind_int)
+	{
+		const int *values = reinterpret_cast<const int *>(record.payload);
+		for (size_t i = 0; i < record.size / sizeof(int); i++)
+			*sink << values[i] << ' ';
+	}
+	else
+	{
+		const double *values = reinterpret_cast<const double *>(record.payload);
+		for (size_t i = 0; i < record.size / sizeof(double); i++)
+			*sink << values[i] << ' ';
+	}
+	if (record.size / (record.kind == log_kind_int ? sizeof(int) : sizeof(double)) < record.count)
+		*sink << "... (" << record.count << " values)";
+	sink->put('\n');
+}
+
+/*
+Wait for the drain thread to write the records queued so far.
+*/
+void Logger::flush()
+{
+	const uint64_t target = head.load(memory_order_acquire);
+	while (drained.load(memory_order_acquire) < target)
+		this_thread::sleep_for(chrono::microseconds(100));
+	lock_guard<mutex> lock(output_mtx);
+	sink->flush();
+	if (trace_file.is_open())
+		trace_file.flush();
+}
+
+uint64_t Logger::get_dropped() const
+{
+	return dropped.load(memory_order_relaxed);
+}
+
+/*
+Constructor: empty line.
+*/
+LogLine::LogLine(LogLevel _level)
+	: level(_level), buffer(text, sizeof(text)), line(&buffer)
+{
+}
+
+/*
+Destructor: queue the line, truncated to the payload.
+*/
+LogLine::~LogLine()
+{
+	Logger::get().log_text(level, text, buffer.size());
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef __LOGGER_H
+#define __LOGGER_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+
+/*
+Levels of the log records, from the most to the least verbose.
+*/
+enum class LogLevel : std::uint8_t { trace, debug, info, warn, error, off };
+
+/*
+Vectors that are logged as binary records, e.g., the state and the control input at every time step.
+*/
+enum class LogEvent : std::uint16_t { state, control_input, noise_budget, controller_state, estimation_error, num_events };
+
+const std::size_t log_record_bytes = 256;
+const std::size_t log_header_bytes = 24;
+const std::size_t log_payload_bytes = log_record_bytes - log_header_bytes;
+
+/*
+Log record of fixed size, so that it is copied into the ring without allocation. A text record holds a formatted message,
+and a binary record the raw values (int or double) of a vector for an event and a time step. Both are truncated to the
+payload.
+*/
+struct LogRecord
+{
+	std::uint64_t time_ns; // Since the start of the logger.
+	LogLevel level;
+	std::uint8_t kind; // 0: text, 1: int values, 2: double values.
+	std::uint16_t event;
+	std::uint32_t step;
+	std::uint32_t size; // Bytes of the payload in use.
+	std::uint32_t count; // Number of values before the truncation.
+	char payload[log_payload_bytes];
+};
+
+/*
+Process-wide asynchronous logger. The threads that log copy their records into a bounded lock-free ring (multiple
+producers, one consumer) and return; a background thread drains the ring, renders the records and writes them to the sink.
+If the ring is full, the record is dropped and counted rather than waiting, so logging never blocks the control loop.
+Records below the runtime level are rejected by one atomic load, before any formatting. With a trace file, the binary
+records are written to it as they are, header and payload, instead of being rendered.
+*/
+class Logger {
+private:
+	struct Slot
+	{
+		std::atomic<std::uint64_t> sequence; // Position of the record in the slot when it is ready, plus one.
+		LogRecord record;
+	};
+	std::unique_ptr<Slot[]> slots;
+	std::uint64_t capacity;
+	alignas(64) std::atomic<std::uint64_t> head; // Next position claimed by a producer.
+	alignas(64) std::uint64_t tail; // Next position drained, owned by the drain thread.
+	std::atomic<std::uint64_t> drained;
+	std::atomic<std::uint64_t> dropped;
+	std::atomic<int> level;
+	std::atomic<bool> stop;
+	std::chrono::steady_clock::time_point start;
+	std::ostream *sink;
+	std::ofstream trace_file;
+	std::mutex output_mtx; // Between the drain thread and set_sink, set_trace_file and flush.
+	std::thread drain_thread;
+
+	Logger(std::size_t _capacity);
+	LogRecord *claim(LogLevel _level, std::uint64_t &position);
+	void publish(std::uint64_t position);
+	template <typename T> bool log_raw(LogLevel _level, LogEvent event, std::uint32_t step, std::uint8_t kind, 
+		const std::vector<T> &values);
+	void drain();
+	void write(const LogRecord &record);
+
+public:
+	static Logger &get();
+	~Logger();
+
+	/*
+	Set the runtime level: records below it are not formatted nor queued. The default is info.
+	*/
+	void set_level(LogLevel _level);
+	bool enabled(LogLevel _level) const { return static_cast<int>(_level) >= level.load(std::memory_order_relaxed); }
+
+	/*
+	Set the stream that the records are rendered to (std::cout by default), and a file for the binary records.
+	*/
+	void set_sink(std::ostream &stream);
+	void set_trace_file(const std::string &path);
+
+	/*
+	Queue a text record, or a binary record of the values of a vector. Return false if the record was dropped.
+	*/
+	bool log_text(LogLevel _level, const char *text, std::size_t size);
+	bool log_values(LogLevel _level, LogEvent event, std::uint32_t step, const std::vector<int> &values);
+	bool log_values(LogLevel _level, LogEvent event, std::uint32_t step, const std::vector<double> &values);
+
+	/*
+	Wait until the records queued before the call are written, and flush the sink.
+	*/
+	void flush();
+	std::uint64_t get_dropped() const;
+
+};
+
+/*
+Text record under construction: the message is formatted into a fixed buffer of the size of the payload, and queued when
+the line is destroyed.
+*/
+class LogLine {
+private:
+	class Buffer : public std::streambuf {
+	public:
+		Buffer(char *data, std::size_t size) { setp(data, data + size); }
+		std::size_t size() const { return pptr() - pbase(); }
+	};
+	LogLevel level;
+	char text[log_payload_bytes];
+	Buffer buffer;
+	std::ostream line;
+
+public:
+	LogLine(LogLevel _level);
+	~LogLine();
+	std::ostream &stream() { return line; }
+
+};
+
+/*
+Records below LOG_COMPILE_LEVEL (the index of a LogLevel, 0 for trace by default) are compiled out. The others cost one
+atomic load when they are below the runtime level, and their arguments are only evaluated when they are logged.
+*/
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+#define LOG_ENABLED(level) (static_cast<int>(level) >= LOG_COMPILE_LEVEL && Logger::get().enabled(level))
+#define LOG_AT(level, message) do { if (LOG_ENABLED(level)) { LogLine log_line_(level); log_line_.stream() << message; } } \
+	while (0)
+#define LOG_DEBUG(message) LOG_AT(LogLevel::debug, message)
+#define LOG_INFO(message) LOG_AT(LogLevel::info, message)
+#define LOG_WARN(message) LOG_AT(LogLevel::warn, message)
+#define LOG_ERROR(message) LOG_AT(LogLevel::error, message)
+#define LOG_VALUES(level, event, step, values) do { if (LOG_ENABLED(level)) Logger::get().log_values(level, event, step, \
+	values); } while (0)
+#define LOG_TRACE(event, step, values) LOG_VALUES(LogLevel::trace, event, step, values)
+
+#include "Logger.cpp"
+
+#endif
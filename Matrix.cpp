@@ -2,6 +2,7 @@
 #define __MATRIX_CPP
 
 #include "Matrix.h"
+#include "MatrixKernels.h"
 #include <iostream>
 
 using namespace std;
@@ -23,11 +24,7 @@ Parameter Constructor.
 template<typename T>
 Matrix<T>::Matrix(unsigned _rows, unsigned _cols, const T& _initial) 
 {
-	mat.resize(_rows);
-	for (unsigned i=0; i<_rows; i++) 
-	{
-		mat[i].resize(_cols, _initial);
-	}
+	mat.assign((std::size_t)_rows * _cols, _initial);
 	rows = _rows;
 	cols = _cols;
 }
@@ -38,15 +35,7 @@ Constructor with elements.
 template<typename T>
 Matrix<T>::Matrix(unsigned _rows, unsigned _cols, const T _values[]) 
 {
-	mat.resize(_rows);
-	for (unsigned i=0; i<_rows; i++) 
-	{
-		mat[i].resize(_cols);
-		for (unsigned j=0; j<_cols; j++) 
-		{
-			mat[i][j] = _values[i * _cols + j];
-		}
-	}
+	mat.assign(_values, _values + (std::size_t)_rows * _cols);
 	rows = _rows;
 	cols = _cols;
 }
@@ -77,24 +66,9 @@ Matrix<T>& Matrix<T>::operator=(const Matrix<T>& rhs)
 	if (&rhs == this)
 		return *this;
 
-	unsigned new_rows = rhs.get_rows();
-	unsigned new_cols = rhs.get_cols();
-
-	mat.resize(new_rows);
-	for (unsigned i=0; i<mat.size(); i++) 
-	{
-		mat[i].resize(new_cols);
-	}
-
-	for (unsigned i=0; i<new_rows; i++) 
-	{
-    	for (unsigned j=0; j<new_cols; j++) 
-    	{
-			mat[i][j] = rhs(i, j);
-		}
-	}
-	rows = new_rows;
-	cols = new_cols;
+	mat = rhs.mat;
+	rows = rhs.get_rows();
+	cols = rhs.get_cols();
 
 	return *this;
 }
@@ -117,7 +91,7 @@ Matrix<T> Matrix<T>::operator+(const Matrix<T>& rhs)
 		{
 			for (unsigned j=0; j<cols; j++) 
 			{
-				result(i,j) = this->mat[i][j] + rhs(i,j);
+				result(i,j) = this->mat[i * cols + j] + rhs(i,j);
 			}
 		}
 
@@ -152,7 +126,7 @@ Matrix<T>& Matrix<T>::operator+=(const Matrix<T>& rhs)
 		{
 			for (unsigned j=0; j<cols; j++) 
 			{
-				this->mat[i][j] += rhs(i,j);
+				this->mat[i * cols + j] += rhs(i,j);
 			}
 		}
 	}
@@ -183,7 +157,7 @@ Matrix<T> Matrix<T>::operator-(const Matrix<T>& rhs)
 		{
 			for (unsigned j=0; j<cols; j++) 
 			{
-				result(i,j) = this->mat[i][j] - rhs(i,j);
+				result(i,j) = this->mat[i * cols + j] - rhs(i,j);
 			}
 		}
 
@@ -218,7 +192,7 @@ Matrix<T>& Matrix<T>::operator-=(const Matrix<T>& rhs)
 		{
 			for (unsigned j=0; j<cols; j++) 
 			{
-				this->mat[i][j] -= rhs(i,j);
+				this->mat[i * cols + j] -= rhs(i,j);
 			}
 		}
 	}
@@ -238,25 +212,14 @@ template<typename T>
 Matrix<T> Matrix<T>::operator*(const Matrix<T>& rhs) 
 {
 
-	unsigned rows = (*this).get_rows();
-	unsigned cols = rhs.get_cols();
-	Matrix result(rows, cols, 0.0);
+	Matrix result(rows, rhs.get_cols(), 0.0);
 
 	try 
 	{
-		if ((*this).cols != rhs.get_rows()) 
+		if (cols != rhs.get_rows()) 
 			throw "Dimensions incompatible!";
 
-		for (unsigned i=0; i<rows; i++) 
-		{
-			for (unsigned j=0; j<cols; j++) 
-			{
-				for (unsigned k=0; k<rows; k++) 
-				{
-					result(i,j) += this->mat[i][k] * rhs(k,j);
-				}
-			}
-		}
+		matrix_kernels::gemm(this->data(), rhs.data(), result.data(), rows, cols, rhs.get_cols());
 	}
 
 	catch(const char* msg) {
@@ -286,15 +249,9 @@ Calculate a transpose of this matrix.
 template<typename T>
 Matrix<T> Matrix<T>::transpose() 
 {
-	Matrix result(rows, cols, 0.0);
+	Matrix result(cols, rows, 0.0);
 
-	for (unsigned i=0; i<rows; i++) 
-	{
-		for (unsigned j=0; j<cols; j++) 
-		{
-			result(i,j) = this->mat[j][i];
-		}
-	}
+	matrix_kernels::transpose(this->data(), result.data(), rows, cols);
 
 	return result;
 }
@@ -311,7 +268,7 @@ Matrix<T> Matrix<T>::operator+(const T& rhs)
 	{
 		for (unsigned j=0; j<cols; j++) 
 		{
-      		result(i,j) = this->mat[i][j] + rhs;
+      		result(i,j) = this->mat[i * cols + j] + rhs;
 		}
 	}
 
@@ -330,7 +287,7 @@ Matrix<T> Matrix<T>::operator-(const T& rhs)
 	{
 		for (unsigned j=0; j<cols; j++) 
 		{
-			result(i,j) = this->mat[i][j] - rhs;
+			result(i,j) = this->mat[i * cols + j] - rhs;
 		}
 	}
 
@@ -349,7 +306,7 @@ Matrix<T> Matrix<T>::operator*(const T& rhs)
 	{
 		for (unsigned j=0; j<cols; j++) 
 		{
-			result(i,j) = this->mat[i][j] * rhs;
+			result(i,j) = this->mat[i * cols + j] * rhs;
 		}
 	}
 
@@ -368,7 +325,7 @@ Matrix<T> Matrix<T>::operator/(const T& rhs)
 	{
 		for (unsigned j=0; j<cols; j++) 
     	{
-			result(i,j) = this->mat[i][j] / rhs;
+			result(i,j) = this->mat[i * cols + j] / rhs;
 		}
 	}
 
@@ -389,13 +346,7 @@ std::vector<T> Matrix<T>::operator*(const std::vector<T>& rhs)
 		if ((*this).cols != rhs.size()) 
 			throw "Dimensions incompatible!";
 
-		for (unsigned i=0; i<rows; i++) 
-		{
-			for (unsigned j=0; j<cols; j++) 
-			{
-				result[i] += this->mat[i][j] * rhs[j];
-			}
-		}
+		matrix_kernels::gemv(this->data(), rhs.data(), result.data(), rows, cols);
 	}
 	catch(const char* msg) {
 		cout << msg << endl;
@@ -415,7 +366,7 @@ std::vector<T> Matrix<T>::diag_vec()
 
 	for (unsigned i=0; i<rows; i++) 
 	{
-		result[i] = this->mat[i][i];
+		result[i] = this->mat[i * cols + i];
 	}
 
 	return result;
@@ -428,7 +379,7 @@ Access the individual elements.
 template<typename T>
 T& Matrix<T>::operator()(const unsigned& row, const unsigned& col) 
 {
-	return this->mat[row][col];
+	return this->mat[row * cols + col];
 }
 
 /* 
@@ -437,7 +388,7 @@ Access the individual elements (const).
 template<typename T>
 const T& Matrix<T>::operator()(const unsigned& row, const unsigned& col) const 
 {
-	return this->mat[row][col];
+	return this->mat[row * cols + col];
 }
 
 /* 
@@ -458,6 +409,24 @@ unsigned Matrix<T>::get_cols() const
 	return this->cols;
 }
 
+/* 
+Access the row-major buffer.
+*/
+template<typename T>
+T* Matrix<T>::data() 
+{
+	return this->mat.data();
+}
+
+/* 
+Access the row-major buffer (const).
+*/
+template<typename T>
+const T* Matrix<T>::data() const 
+{
+	return this->mat.data();
+}
+
 /* 
 Print matrix.
 */
@@ -468,12 +437,30 @@ void Matrix<T>::print()
 	{
 		for (int j=0; j<cols; j++) 
 		{
-			std::cout << this->mat[i][j] << " ";
+			std::cout << this->mat[i * cols + j] << " ";
 		}
 	std::cout << std::endl;
 	}
 }
 
+/* 
+Write matrix on one line.
+*/
+template<typename T>
+std::ostream& operator<<(std::ostream& stream, const Matrix<T>& matrix)
+{
+	for (unsigned i=0; i<matrix.get_rows(); i++) 
+	{
+		for (unsigned j=0; j<matrix.get_cols(); j++) 
+		{
+			stream << matrix(i, j) << " ";
+		}
+		if (i + 1 < matrix.get_rows())
+			stream << "; ";
+	}
+	return stream;
+}
+
 
 
 #endif
\ No newline at end of file
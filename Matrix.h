@@ -2,14 +2,21 @@
 #define __MATRIX_H
 
 #include <vector>
+#include <iostream>
 
+/*
+Dense matrix stored in a single row-major buffer: element (i,j) is at mat[i * cols + j].
+*/
 template <typename T> class Matrix {
 private:
-	std::vector<std::vector<T> > mat;
+	std::vector<T> mat;
 	unsigned rows;
 	unsigned cols;
 
 public:
+	typedef std::vector<T> input_vector; // Type of the vectors that the matrix multiplies.
+	typedef std::vector<T> output_vector; // Type of the products with a vector.
+
 	Matrix();
 	Matrix(unsigned _rows, unsigned _cols, const T& _initial);
 	Matrix(unsigned _rows, unsigned _cols, const T _values[]);
@@ -59,8 +66,20 @@ public:
 	unsigned get_cols() const;
 	void print();
 
+	/* 
+	Access the row-major buffer, e.g., for the kernels.
+	*/
+	T* data();
+	const T* data() const;
+
 };
 
+/*
+Write a matrix on one line, with the rows separated by semicolons, e.g., for a log record.
+*/
+template <typename T>
+std::ostream& operator<<(std::ostream& stream, const Matrix<T>& matrix);
+
 #include "Matrix.cpp"
 
 #endif
\ No newline at end of file
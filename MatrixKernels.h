@@ -0,0 +1,383 @@
+#ifndef __MATRIXKERNELS_H
+#define __MATRIXKERNELS_H
+
+#include <algorithm>
+
+/*
+The AVX2 kernels are compiled for the AVX2 target function by function, with the rest of the program left at the baseline 
+target, and are only called if the CPU supports AVX2. Building with ENABLE_AVX2 turns them on.
+*/
+#if defined(ENABLE_AVX2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+Kernels on row-major buffers for the Matrix<T> operations. The generic versions work for any T and are cache-blocked; the
+int and double overloads use AVX2 versions when the CPU supports it, and the generic versions otherwise.
+*/
+namespace matrix_kernels {
+
+const unsigned block_size = 64; // Side of the cache blocks, in elements.
+
+/*
+Matrix/vector product: y = A*x, with A of size rows x cols.
+*/
+template <typename T>
+inline void gemv(const T *A, const T *x, T *y, unsigned rows, unsigned cols)
+{
+	for (unsigned i=0; i<rows; i++)
+	{
+		const T *a = A + (std::size_t)i * cols;
+		T sum = y[i];
+		for (unsigned j=0; j<cols; j++)
+		{
+			sum += a[j] * x[j];
+		}
+		y[i] = sum;
+	}
+}
+
+/*
+Matrix product: C += A*B, with A of size rows x inner and B of size inner x cols. The loops are ordered i-k-j and blocked, so
+that the inner loop streams through contiguous rows of B and C.
+*/
+template <typename T>
+inline void gemm(const T *A, const T *B, T *C, unsigned rows, unsigned inner, unsigned cols)
+{
+	for (unsigned ii=0; ii<rows; ii+=block_size)
+	for (unsigned kk=0; kk<inner; kk+=block_size)
+	for (unsigned jj=0; jj<cols; jj+=block_size)
+	{
+		const unsigned i_end = std::min(ii + block_size, rows);
+		const unsigned k_end = std::min(kk + block_size, inner);
+		const unsigned j_end = std::min(jj + block_size, cols);
+		for (unsigned i=ii; i<i_end; i++)
+		{
+			T *c = C + (std::size_t)i * cols;
+			for (unsigned k=kk; k<k_end; k++)
+			{
+				const T a = A[(std::size_t)i * inner + k];
+				const T *b = B + (std::size_t)k * cols;
+				for (unsigned j=jj; j<j_end; j++)
+				{
+					c[j] += a * b[j];
+				}
+			}
+		}
+	}
+}
+
+/*
+Transpose: B = A^T, with A of size rows x cols, by blocks.
+*/
+template <typename T>
+inline void transpose(const T *A, T *B, unsigned rows, unsigned cols)
+{
+	for (unsigned ii=0; ii<rows; ii+=block_size)
+	for (unsigned jj=0; jj<cols; jj+=block_size)
+	{
+		const unsigned i_end = std::min(ii + block_size, rows);
+		const unsigned j_end = std::min(jj + block_size, cols);
+		for (unsigned i=ii; i<i_end; i++)
+		{
+			for (unsigned j=jj; j<j_end; j++)
+			{
+				B[(std::size_t)j * rows + i] = A[(std::size_t)i * cols + j];
+			}
+		}
+	}
+}
+
+#ifdef MATRIX_KERNELS_AVX2
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+/*
+Whether the CPU supports AVX2, checked once.
+*/
+inline bool cpu_has_avx2()
+{
+	static const bool supported = __builtin_cpu_supports("avx2");
+	return supported;
+}
+
+/*
+Horizontal sums of AVX2 registers.
+*/
+AVX2_TARGET inline int hsum(__m256i v)
+{
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(s);
+}
+
+AVX2_TARGET inline double hsum(__m256d v)
+{
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+	s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+	return _mm_cvtsd_f64(s);
+}
+
+/*
+Matrix/vector product for int: 8 products per instruction.
+*/
+AVX2_TARGET inline void gemv_avx2(const int *A, const int *x, int *y, unsigned rows, unsigned cols)
+{
+	for (unsigned i=0; i<rows; i++)
+	{
+		const int *a = A + (std::size_t)i * cols;
+		__m256i acc = _mm256_setzero_si256();
+		unsigned j = 0;
+		for (; j+8<=cols; j+=8)
+		{
+			__m256i va = _mm256_loadu_si256((const __m256i *)(a + j));
+			__m256i vx = _mm256_loadu_si256((const __m256i *)(x + j));
+			acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(va, vx));
+		}
+		int sum = y[i] + hsum(acc);
+		for (; j<cols; j++)
+		{
+			sum += a[j] * x[j];
+		}
+		y[i] = sum;
+	}
+}
+
+/*
+Matrix/vector product for double: 4 products per instruction.
+*/
+AVX2_TARGET inline void gemv_avx2(const double *A, const double *x, double *y, unsigned rows, unsigned cols)
+{
+	for (unsigned i=0; i<rows; i++)
+	{
+		const double *a = A + (std::size_t)i * cols;
+		__m256d acc = _mm256_setzero_pd();
+		unsigned j = 0;
+		for (; j+4<=cols; j+=4)
+		{
+			acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + j), _mm256_loadu_pd(x + j)));
+		}
+		double sum = y[i] + hsum(acc);
+		for (; j<cols; j++)
+		{
+			sum += a[j] * x[j];
+		}
+		y[i] = sum;
+	}
+}
+
+/*
+Matrix product for int, blocked as the generic version, with the inner loop on 8 columns at a time.
+*/
+AVX2_TARGET inline void gemm_avx2(const int *A, const int *B, int *C, unsigned rows, unsigned inner, unsigned cols)
+{
+	for (unsigned ii=0; ii<rows; ii+=block_size)
+	for (unsigned kk=0; kk<inner; kk+=block_size)
+	for (unsigned jj=0; jj<cols; jj+=block_size)
+	{
+		const unsigned i_end = std::min(ii + block_size, rows);
+		const unsigned k_end = std::min(kk + block_size, inner);
+		const unsigned j_end = std::min(jj + block_size, cols);
+		for (unsigned i=ii; i<i_end; i++)
+		{
+			int *c = C + (std::size_t)i * cols;
+			for (unsigned k=kk; k<k_end; k++)
+			{
+				const int a = A[(std::size_t)i * inner + k];
+				const int *b = B + (std::size_t)k * cols;
+				const __m256i va = _mm256_set1_epi32(a);
+				unsigned j = jj;
+				for (; j+8<=j_end; j+=8)
+				{
+					__m256i vc = _mm256_loadu_si256((const __m256i *)(c + j));
+					__m256i vb = _mm256_loadu_si256((const __m256i *)(b + j));
+					_mm256_storeu_si256((__m256i *)(c + j), _mm256_add_epi32(vc, _mm256_mullo_epi32(va, vb)));
+				}
+				for (; j<j_end; j++)
+				{
+					c[j] += a * b[j];
+				}
+			}
+		}
+	}
+}
+
+/*
+Matrix product for double, blocked as the generic version, with the inner loop on 4 columns at a time.
+*/
+AVX2_TARGET inline void gemm_avx2(const double *A, const double *B, double *C, unsigned rows, unsigned inner, unsigned cols)
+{
+	for (unsigned ii=0; ii<rows; ii+=block_size)
+	for (unsigned kk=0; kk<inner; kk+=block_size)
+	for (unsigned jj=0; jj<cols; jj+=block_size)
+	{
+		const unsigned i_end = std::min(ii + block_size, rows);
+		const unsigned k_end = std::min(kk + block_size, inner);
+		const unsigned j_end = std::min(jj + block_size, cols);
+		for (unsigned i=ii; i<i_end; i++)
+		{
+			double *c = C + (std::size_t)i * cols;
+			for (unsigned k=kk; k<k_end; k++)
+			{
+				const double a = A[(std::size_t)i * inner + k];
+				const double *b = B + (std::size_t)k * cols;
+				const __m256d va = _mm256_set1_pd(a);
+				unsigned j = jj;
+				for (; j+4<=j_end; j+=4)
+				{
+					__m256d vc = _mm256_loadu_pd(c + j);
+					_mm256_storeu_pd(c + j, _mm256_add_pd(vc, _mm256_mul_pd(va, _mm256_loadu_pd(b + j))));
+				}
+				for (; j<j_end; j++)
+				{
+					c[j] += a * b[j];
+				}
+			}
+		}
+	}
+}
+
+/*
+Transpose for int: 8x8 tiles are transposed in registers, the borders element by element.
+*/
+AVX2_TARGET inline void transpose_avx2(const int *A, int *B, unsigned rows, unsigned cols)
+{
+	const unsigned rows8 = rows - rows % 8;
+	const unsigned cols8 = cols - cols % 8;
+	for (unsigned ii=0; ii<rows8; ii+=block_size)
+	for (unsigned jj=0; jj<cols8; jj+=block_size)
+	{
+		const unsigned i_end = std::min(ii + block_size, rows8);
+		const unsigned j_end = std::min(jj + block_size, cols8);
+		for (unsigned i=ii; i<i_end; i+=8)
+		for (unsigned j=jj; j<j_end; j+=8)
+		{
+			__m256i r[8], t[8], u[8];
+			for (unsigned l=0; l<8; l++)
+			{
+				r[l] = _mm256_loadu_si256((const __m256i *)(A + (std::size_t)(i + l) * cols + j));
+			}
+			for (unsigned l=0; l<8; l+=2)
+			{
+				t[l] = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+				t[l + 1] = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+			}
+			for (unsigned l=0; l<8; l+=4)
+			{
+				u[l] = _mm256_unpacklo_epi64(t[l], t[l + 2]);
+				u[l + 1] = _mm256_unpackhi_epi64(t[l], t[l + 2]);
+				u[l + 2] = _mm256_unpacklo_epi64(t[l + 1], t[l + 3]);
+				u[l + 3] = _mm256_unpackhi_epi64(t[l + 1], t[l + 3]);
+			}
+			for (unsigned l=0; l<4; l++)
+			{
+				_mm256_storeu_si256((__m256i *)(B + (std::size_t)(j + l) * rows + i), _mm256_permute2x128_si256(u[l], u[l + 4], 0x20));
+				_mm256_storeu_si256((__m256i *)(B + (std::size_t)(j + l + 4) * rows + i), _mm256_permute2x128_si256(u[l], u[l + 4], 0x31));
+			}
+		}
+	}
+	for (unsigned i=0; i<rows; i++)
+	{
+		for (unsigned j=(i < rows8 ? cols8 : 0); j<cols; j++)
+		{
+			B[(std::size_t)j * rows + i] = A[(std::size_t)i * cols + j];
+		}
+	}
+}
+
+/*
+Transpose for double: 4x4 tiles are transposed in registers, the borders element by element.
+*/
+AVX2_TARGET inline void transpose_avx2(const double *A, double *B, unsigned rows, unsigned cols)
+{
+	const unsigned rows4 = rows - rows % 4;
+	const unsigned cols4 = cols - cols % 4;
+	for (unsigned ii=0; ii<rows4; ii+=block_size)
+	for (unsigned jj=0; jj<cols4; jj+=block_size)
+	{
+		const unsigned i_end = std::min(ii + block_size, rows4);
+		const unsigned j_end = std::min(jj + block_size, cols4);
+		for (unsigned i=ii; i<i_end; i+=4)
+		for (unsigned j=jj; j<j_end; j+=4)
+		{
+			__m256d r0 = _mm256_loadu_pd(A + (std::size_t)i * cols + j);
+			__m256d r1 = _mm256_loadu_pd(A + (std::size_t)(i + 1) * cols + j);
+			__m256d r2 = _mm256_loadu_pd(A + (std::size_t)(i + 2) * cols + j);
+			__m256d r3 = _mm256_loadu_pd(A + (std::size_t)(i + 3) * cols + j);
+			__m256d t0 = _mm256_unpacklo_pd(r0, r1);
+			__m256d t1 = _mm256_unpackhi_pd(r0, r1);
+			__m256d t2 = _mm256_unpacklo_pd(r2, r3);
+			__m256d t3 = _mm256_unpackhi_pd(r2, r3);
+			_mm256_storeu_pd(B + (std::size_t)j * rows + i, _mm256_permute2f128_pd(t0, t2, 0x20));
+			_mm256_storeu_pd(B + (std::size_t)(j + 1) * rows + i, _mm256_permute2f128_pd(t1, t3, 0x20));
+			_mm256_storeu_pd(B + (std::size_t)(j + 2) * rows + i, _mm256_permute2f128_pd(t0, t2, 0x31));
+			_mm256_storeu_pd(B + (std::size_t)(j + 3) * rows + i, _mm256_permute2f128_pd(t1, t3, 0x31));
+		}
+	}
+	for (unsigned i=0; i<rows; i++)
+	{
+		for (unsigned j=(i < rows4 ? cols4 : 0); j<cols; j++)
+		{
+			B[(std::size_t)j * rows + i] = A[(std::size_t)i * cols + j];
+		}
+	}
+}
+
+/*
+Dispatch of the int and double operations: the AVX2 version if the CPU supports it, the generic version otherwise.
+*/
+inline void gemv(const int *A, const int *x, int *y, unsigned rows, unsigned cols)
+{
+	if (cpu_has_avx2())
+		gemv_avx2(A, x, y, rows, cols);
+	else
+		gemv<int>(A, x, y, rows, cols);
+}
+
+inline void gemv(const double *A, const double *x, double *y, unsigned rows, unsigned cols)
+{
+	if (cpu_has_avx2())
+		gemv_avx2(A, x, y, rows, cols);
+	else
+		gemv<double>(A, x, y, rows, cols);
+}
+
+inline void gemm(const int *A, const int *B, int *C, unsigned rows, unsigned inner, unsigned cols)
+{
+	if (cpu_has_avx2())
+		gemm_avx2(A, B, C, rows, inner, cols);
+	else
+		gemm<int>(A, B, C, rows, inner, cols);
+}
+
+inline void gemm(const double *A, const double *B, double *C, unsigned rows, unsigned inner, unsigned cols)
+{
+	if (cpu_has_avx2())
+		gemm_avx2(A, B, C, rows, inner, cols);
+	else
+		gemm<double>(A, B, C, rows, inner, cols);
+}
+
+inline void transpose(const int *A, int *B, unsigned rows, unsigned cols)
+{
+	if (cpu_has_avx2())
+		transpose_avx2(A, B, rows, cols);
+	else
+		transpose<int>(A, B, rows, cols);
+}
+
+inline void transpose(const double *A, double *B, unsigned rows, unsigned cols)
+{
+	if (cpu_has_avx2())
+		transpose_avx2(A, B, rows, cols);
+	else
+		transpose<double>(A, B, rows, cols);
+}
+
+#endif
+
+}
+
+#endif
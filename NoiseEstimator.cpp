@@ -0,0 +1,92 @@
+#ifndef __NOISEESTIMATOR_CPP
+#define __NOISEESTIMATOR_CPP
+
+#include <cmath>
+#include <algorithm>
+
+#include "NoiseEstimator.h"
+
+using namespace std;
+using namespace seal;
+
+
+/*
+Constructor: precompute the logarithms of the parameters and the budget of key switching, whose decomposition has one 
+digit of min(2^decomposition_bit_count, prime) per decomposition_bit_count bits of every prime.
+*/
+NoiseEstimator::NoiseEstimator(size_t poly_modulus_degree, uint64_t plain_modulus, const vector<SmallModulus> &coeff_modulus, 
+	int decomposition_bit_count)
+{
+	log_N = log2(static_cast<double>(poly_modulus_degree));
+	log_t = log2(static_cast<double>(plain_modulus));
+	coeff_modulus_bits = 0;
+	int max_prime_bits = 0;
+	for (const SmallModulus &prime : coeff_modulus)
+	{
+		coeff_modulus_bits += prime.bit_count();
+		max_prime_bits = max(max_prime_bits, prime.bit_count());
+	}
+	last_prime_bits = coeff_modulus.size() > 1 ? coeff_modulus[0].bit_count() : 0;
+	const int digits = coeff_modulus.size() * ((max_prime_bits + decomposition_bit_count - 1) / decomposition_bit_count);
+	key_switching_budget = coeff_modulus_bits - (log_t + min(decomposition_bit_count, max_prime_bits) + log_N / 2 
+		+ log2(max(digits, 1)) + 3);
+}
+
+NoiseEstimator::NoiseEstimator(const EncryptionParameters &parms, int decomposition_bit_count)
+	: NoiseEstimator(parms.poly_modulus_degree(), parms.plain_modulus().value(), parms.coeff_modulus(), 
+		decomposition_bit_count)
+{
+}
+
+double NoiseEstimator::fresh() const
+{
+	return coeff_modulus_bits - (log_t + log_N / 2 + 4);
+}
+
+double NoiseEstimator::multiply_plain(double budget, double plain_norm) const
+{
+	return budget - log2(max(plain_norm, 1.0));
+}
+
+double NoiseEstimator::multiply_plain_batched(double budget) const
+{
+	return budget - (log_N / 2 + log_t - 1);
+}
+
+double NoiseEstimator::add(double budget, unsigned terms) const
+{
+	return budget - log2(max(terms, 1u));
+}
+
+double NoiseEstimator::multiply(double budget1, double budget2) const
+{
+	return min(budget1, budget2) - (log_t + log_N + 1);
+}
+
+/*
+The noise of key switching is added to the noise of the input, which costs one more bit when both are of the same size.
+*/
+double NoiseEstimator::key_switch(double budget) const
+{
+	return min(budget, key_switching_budget) - 1;
+}
+
+/*
+Without a smaller level, modulus switching is a no-op.
+*/
+double NoiseEstimator::mod_switch(double budget) const
+{
+	if (last_prime_bits == 0)
+		return budget;
+	return min(budget, last_prime_bits - (log_t + log_N / 2 + 3));
+}
+
+double NoiseEstimator::integer_plain_norm(int64_t bound)
+{
+	int digits = 0;
+	for (; bound > 0; bound >>= 1)
+		digits++;
+	return max(digits, 1);
+}
+
+#endif
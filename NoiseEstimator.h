@@ -0,0 +1,65 @@
+#ifndef __NOISEESTIMATOR_H
+#define __NOISEESTIMATOR_H
+
+#include <vector>
+#include <cstdint>
+
+#include "seal/seal.h"
+
+/*
+Default threshold, in bits, of the estimated budget below which a ciphertext has to be refreshed.
+*/
+const double refresh_threshold_bits = 4;
+
+/*
+Static estimate of the invariant noise budget of BFV ciphertexts, in bits, without the secret key. The budget of a fresh 
+encryption follows from the parameters, and every homomorphic operation maps the budgets of its inputs to the budget of 
+its output, with the usual average-case bounds on the noise growth:
+- fresh encryption: noise t*sqrt(N)*sigma;
+- multiply_plain: the noise is scaled by the size of the plaintext, given as the sum of the absolute values of its 
+coefficients: a few for the IntegerEncoder and for constants, and t*sqrt(N)/2 for general batched plaintexts;
+- add: a sum of terms adds log2(terms) bits;
+- multiply: the noise is scaled by t*N;
+- key switching (relinearization and rotations): adds noise of t*sqrt(N) times the decomposition base;
+- modulus switching to the last prime: adds the rounding noise of that prime.
+The estimate is a heuristic and is meant to be used with a margin of a few bits.
+*/
+class NoiseEstimator {
+private:
+	double log_N;
+	double log_t;
+	int coeff_modulus_bits;
+	int last_prime_bits; // Bits of the prime that is left after modulus switching to the last level.
+	double key_switching_budget; // Budget of the noise added by key switching.
+
+public:
+	NoiseEstimator(std::size_t poly_modulus_degree, std::uint64_t plain_modulus, 
+		const std::vector<seal::SmallModulus> &coeff_modulus, int decomposition_bit_count);
+	NoiseEstimator(const seal::EncryptionParameters &parms, int decomposition_bit_count);
+
+	/*
+	Budget of a fresh encryption.
+	*/
+	double fresh() const;
+
+	/*
+	Budget after each operation, given the budgets of the inputs.
+	*/
+	double multiply_plain(double budget, double plain_norm) const;
+	double multiply_plain_batched(double budget) const;
+	double add(double budget, unsigned terms = 2) const;
+	double multiply(double budget1, double budget2) const;
+	double key_switch(double budget) const;
+	double mod_switch(double budget) const;
+
+	/*
+	Size of the IntegerEncoder encoding of an integer of absolute value at most bound, to be passed to multiply_plain: 
+	the number of its binary digits.
+	*/
+	static double integer_plain_norm(std::int64_t bound);
+
+};
+
+#include "NoiseEstimator.cpp"
+
+#endif
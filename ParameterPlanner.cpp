@@ -0,0 +1,282 @@
+#ifndef __PARAMETERPLANNER_CPP
+#define __PARAMETERPLANNER_CPP
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+
+#include "ParameterPlanner.h"
+#include "helper.h"
+#include "NoiseEstimator.h"
+
+using namespace std;
+using namespace seal;
+
+
+/*
+Number of binary digits of a nonnegative bound, which is the number of nonzero coefficients of its IntegerEncoder encoding
+in the worst case.
+*/
+static int bit_length(int64_t value)
+{
+	int length = 0;
+	while (value > 0)
+	{
+		length++;
+		value >>= 1;
+	}
+	return max(length, 1);
+}
+
+/*
+Deterministic Miller-Rabin test for 64-bit integers.
+*/
+static bool is_prime(uint64_t value)
+{
+	if (value < 2)
+		return false;
+	const uint64_t bases[12] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+	for (uint64_t base : bases)
+		if (value % base == 0)
+			return value == base;
+	uint64_t d = value - 1;
+	int s = 0;
+	while ((d & 1) == 0)
+	{
+		d >>= 1;
+		s++;
+	}
+	for (uint64_t base : bases)
+	{
+		unsigned __int128 x = 1, power = base;
+		for (uint64_t e = d; e > 0; e >>= 1)
+		{
+			if (e & 1)
+				x = x * power % value;
+			power = power * power % value;
+		}
+		if (x == 1 || x == value - 1)
+			continue;
+		bool composite = true;
+		for (int r = 1; r < s && composite; r++)
+		{
+			x = x * x % value;
+			composite = (x != value - 1);
+		}
+		if (composite)
+			return false;
+	}
+	return true;
+}
+
+/*
+Default coefficient modulus of SEAL for a degree and a security level, which has the most bits the level allows.
+*/
+static vector<SmallModulus> max_coeff_modulus(size_t poly_modulus_degree, int security_level)
+{
+	if (security_level == 256)
+		return coeff_modulus_256(poly_modulus_degree);
+	if (security_level == 192)
+		return coeff_modulus_192(poly_modulus_degree);
+	return coeff_modulus_128(poly_modulus_degree);
+}
+
+static int total_bits(const vector<SmallModulus> &coeff_modulus)
+{
+	int bits = 0;
+	for (const SmallModulus &prime : coeff_modulus)
+		bits += prime.bit_count();
+	return bits;
+}
+
+/*
+Estimated noise budget, in bits, left in the control input after update_control with fresh encryptions of x (and K), 
+through the operations of the gain mode.
+*/
+static double estimate_budget(const PlanRequirements &requirements, size_t poly_modulus_degree, uint64_t plain_modulus,
+	const vector<SmallModulus> &coeff_modulus)
+{
+	NoiseEstimator estimator(poly_modulus_degree, plain_modulus, coeff_modulus, decomposition_bit_count);
+	const unsigned d = max(requirements.n, requirements.m);
+	double budget = estimator.fresh();
+	switch (requirements.mode)
+	{
+	case GainMode::plain:
+		budget = estimator.add(estimator.multiply_plain(budget, NoiseEstimator::integer_plain_norm(requirements.bound_K)), requirements.n);
+		break;
+	case GainMode::encrypted:
+		budget = estimator.add(estimator.multiply(budget, estimator.fresh()), requirements.n);
+		budget = estimator.mod_switch(estimator.key_switch(budget));
+		break;
+	case GainMode::packed:
+	{
+		const unsigned g = diagonal_baby_steps(d);
+		const unsigned giant_steps = (d + g - 1) / g;
+		if (g > 1)
+			budget = estimator.key_switch(budget);
+		budget = estimator.add(estimator.multiply_plain_batched(budget), g);
+		if (giant_steps > 1)
+			budget = estimator.key_switch(budget);
+		budget = estimator.add(budget, giant_steps);
+		break;
+	}
+	case GainMode::multiplexed:
+		budget = estimator.add(estimator.multiply_plain(budget, requirements.bound_K), requirements.n);
+		break;
+	}
+	return budget;
+}
+
+/*
+Smallest plaintext modulus for the degree: a power of 2 above twice the largest coefficient of the product of the
+IntegerEncoder encodings, or with batching the smallest prime congruent to 1 modulo 2*poly_modulus_degree above twice
+the largest value. Returns 0 if there is none below 2^60.
+*/
+static uint64_t plain_modulus_for(const PlanRequirements &requirements, size_t poly_modulus_degree, int64_t bound_x,
+	int64_t bound_u)
+{
+	if (requirements.mode == GainMode::plain || requirements.mode == GainMode::encrypted)
+	{
+		const uint64_t coefficient = requirements.n * static_cast<uint64_t>(min(bit_length(requirements.bound_K),
+			bit_length(bound_x)));
+		uint64_t plain_modulus = 4;
+		while (plain_modulus <= 2 * coefficient)
+			plain_modulus <<= 1;
+		return plain_modulus;
+	}
+	const uint64_t step = 2 * poly_modulus_degree;
+	const uint64_t lower = 2 * static_cast<uint64_t>(max(bound_u, bound_x));
+	for (uint64_t plain_modulus = (lower / step + 1) * step + 1; plain_modulus < (1ULL << 60); plain_modulus += step)
+		if (is_prime(plain_modulus))
+			return plain_modulus;
+	return 0;
+}
+
+/*
+Pick the smallest parameters for the requirements.
+*/
+ParameterPlan plan_parameters(const PlanRequirements &requirements)
+{
+	if (requirements.n == 0 || requirements.m == 0 || requirements.plants == 0)
+		throw invalid_argument("dimensions and number of plants must be positive");
+	if (requirements.bound_A < 0 || requirements.bound_B < 0 || requirements.bound_K < 0 || requirements.bound_x < 0)
+		throw invalid_argument("bounds must be nonnegative");
+	if (requirements.security_level != 128 && requirements.security_level != 192 && requirements.security_level != 256)
+		throw invalid_argument("security level must be 128, 192 or 256");
+
+	/*
+	Bound the state over the horizon and the control input, which are decoded as int.
+	*/
+	const int64_t int_max = numeric_limits<int>::max();
+	int64_t bound_x = requirements.bound_x;
+	int64_t bound_u = 0;
+	for (unsigned k = 0; ; k++)
+	{
+		long double next_u = static_cast<long double>(requirements.n) * requirements.bound_K * bound_x;
+		if (next_u > int_max)
+			throw invalid_argument("the control input can exceed the range of int");
+		bound_u = max(bound_u, static_cast<int64_t>(next_u));
+		if (k == requirements.horizon)
+			break;
+		long double next_x = static_cast<long double>(requirements.n) * requirements.bound_A * bound_x
+			+ static_cast<long double>(requirements.m) * requirements.bound_B * next_u;
+		if (next_x > int_max)
+			throw invalid_argument("the state can exceed the range of int over the horizon");
+		bound_x = max(bound_x, static_cast<int64_t>(next_x));
+	}
+
+	const bool batching = (requirements.mode == GainMode::packed || requirements.mode == GainMode::multiplexed);
+	const int bit_sizes[4] = {30, 40, 50, 60};
+	for (size_t degree = 1024; degree <= 32768; degree <<= 1)
+	{
+		if (requirements.mode == GainMode::packed && 4 * max(requirements.n, requirements.m) > degree)
+			continue;
+		if (requirements.mode == GainMode::multiplexed && requirements.plants > degree)
+			continue;
+		if (!batching && bit_length(requirements.bound_K) + bit_length(bound_x) > degree)
+			continue;
+		const uint64_t plain_modulus = plain_modulus_for(requirements, degree, bound_x, bound_u);
+		if (plain_modulus == 0)
+			continue;
+
+		/*
+		Candidate coefficient moduli within the security bound, cheapest first: fewer primes, then fewer bits. Every
+		operation costs one NTT-sized pass per prime.
+		*/
+		vector<SmallModulus> max_modulus = max_coeff_modulus(degree, requirements.security_level);
+		const int max_bits = total_bits(max_modulus);
+		vector<vector<SmallModulus>> candidates;
+		for (int count = 1; count * bit_sizes[0] <= max_bits; count++)
+			for (int bits : bit_sizes)
+			{
+				if (count * bits > max_bits)
+					break;
+				vector<SmallModulus> coeff_modulus;
+				for (int i = 0; i < count; i++)
+					coeff_modulus.push_back(bits == 30 ? small_mods_30bit(i) : bits == 40 ? small_mods_40bit(i)
+						: bits == 50 ? small_mods_50bit(i) : small_mods_60bit(i));
+				candidates.push_back(coeff_modulus);
+			}
+		candidates.push_back(max_modulus);
+		stable_sort(candidates.begin(), candidates.end(),
+			[](const vector<SmallModulus> &a, const vector<SmallModulus> &b)
+			{
+				return a.size() < b.size() || (a.size() == b.size() && total_bits(a) < total_bits(b));
+			});
+
+		for (const vector<SmallModulus> &coeff_modulus : candidates)
+		{
+			double budget = estimate_budget(requirements, degree, plain_modulus, coeff_modulus);
+			if (budget >= requirements.margin_bits)
+				return {degree, coeff_modulus, plain_modulus, bound_x, bound_u, total_bits(coeff_modulus), budget};
+		}
+	}
+	throw invalid_argument("no encryption parameters up to poly_modulus_degree 32768 meet the requirements");
+}
+
+/*
+Setup the encryption scheme and parameters from a plan.
+*/
+void setup_params(EncryptionParameters &parms, const ParameterPlan &plan)
+{
+	parms.set_poly_modulus_degree(plan.poly_modulus_degree);
+	parms.set_coeff_modulus(plan.coeff_modulus);
+	parms.set_plain_modulus(plan.plain_modulus);
+}
+
+/*
+Print a plan.
+*/
+void print_plan(const ParameterPlan &plan, ostream &stream)
+{
+	stream << plan << endl;
+}
+
+/*
+Tag of the requirements and the planner version.
+*/
+string plan_tag(const PlanRequirements &requirements)
+{
+	ostringstream tag;
+	tag << "planner " << planner_version << " n " << requirements.n << " m " << requirements.m << " bound_A " 
+		<< requirements.bound_A << " bound_B " << requirements.bound_B << " bound_K " << requirements.bound_K 
+		<< " bound_x " << requirements.bound_x << " horizon " << requirements.horizon << " mode " 
+		<< static_cast<int>(requirements.mode) << " security_level " << requirements.security_level << " plants " 
+		<< requirements.plants << " margin_bits " << requirements.margin_bits;
+	return tag.str();
+}
+
+/*
+Write a plan on one line.
+*/
+ostream &operator<<(ostream &stream, const ParameterPlan &plan)
+{
+	return stream << "poly_modulus_degree: " << plan.poly_modulus_degree << ", coeff_modulus: " 
+		<< plan.coeff_modulus.size() << " primes, " << plan.coeff_modulus_bits << " bits, plain_modulus: " 
+		<< plan.plain_modulus << " (|x| <= " << plan.bound_x << ", |u| <= " << plan.bound_u << "), estimated noise budget: " 
+		<< fixed << setprecision(1) << plan.estimated_budget << " bits" << defaultfloat;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef __PARAMETERPLANNER_H
+#define __PARAMETERPLANNER_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+
+#include "seal/seal.h"
+
+/*
+How the controller computes u = K*x, which decides the encoder, the homomorphic operations and therefore the noise: K in
+plaintext or encrypted with the IntegerEncoder, K in diagonals with the BatchEncoder (packed), or K constant over the slots
+for a fleet of plants (multiplexed).
+*/
+enum class GainMode { plain, encrypted, packed, multiplexed };
+
+/*
+What the parameters have to support: the dimensions of the loop, bounds on the absolute values of the entries of A, B, K and
+x, the gain mode and the security level. If horizon is positive, bound_x bounds the initial state and is propagated through
+horizon steps of the closed loop x <- A*x + B*K*x; otherwise it bounds the state at every step.
+*/
+struct PlanRequirements
+{
+	unsigned n, m; // Number of states and of control inputs.
+	std::int64_t bound_A, bound_B, bound_K, bound_x;
+	unsigned horizon;
+	GainMode mode;
+	int security_level = 128; // 128, 192 or 256 bits.
+	unsigned plants = 1; // Plants per ciphertext in the multiplexed mode.
+	int margin_bits = 8; // Noise budget left in the control input on top of the estimate.
+};
+
+/*
+Encryption parameters picked by the planner, the bounds that the plaintext modulus holds, and the estimated noise budget
+left in the control input after update_control.
+*/
+struct ParameterPlan
+{
+	std::size_t poly_modulus_degree;
+	std::vector<seal::SmallModulus> coeff_modulus;
+	std::uint64_t plain_modulus;
+	std::int64_t bound_x, bound_u;
+	int coeff_modulus_bits;
+	double estimated_budget;
+};
+
+/*
+Pick the smallest poly_modulus_degree, and for it the smallest coefficient modulus and plaintext modulus, for which the
+control input is decrypted correctly:
+- the plaintext modulus holds the values of K*x without wrapping around: for the IntegerEncoder, the coefficients of the
+product of the encodings; with batching, the values themselves, and it is a prime congruent to 1 modulo
+2*poly_modulus_degree;
+- the coefficient modulus is within the bound of the security level for the degree, and leaves at least margin_bits of
+noise budget after the operations of the gain mode, by the heuristic estimate of NoiseEstimator.
+Throws invalid_argument if the requirements are inconsistent or no degree up to 32768 fits.
+*/
+ParameterPlan plan_parameters(const PlanRequirements &requirements);
+
+/*
+Version of the planner, to be raised whenever it picks different parameters for the same requirements.
+*/
+const int planner_version = 1;
+
+/*
+All fields of the requirements and the planner version on one line, which identify the plan, e.g., as the tag of the 
+parameters and keys stored in a KeyCache, so that they are regenerated when the requirements or the planner change.
+*/
+std::string plan_tag(const PlanRequirements &requirements);
+
+/*
+Setup the encryption scheme and parameters from a plan.
+*/
+void setup_params(seal::EncryptionParameters &parms, const ParameterPlan &plan);
+
+/*
+Print a plan, or write it on one line, e.g., for a log record.
+*/
+void print_plan(const ParameterPlan &plan, std::ostream &stream);
+std::ostream &operator<<(std::ostream &stream, const ParameterPlan &plan);
+
+#include "ParameterPlanner.cpp"
+
+#endif
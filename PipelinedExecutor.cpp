@@ -0,0 +1,164 @@
+#ifndef __PIPELINEDEXECUTOR_CPP
+#define __PIPELINEDEXECUTOR_CPP
+
+#include <chrono>
+#include <stdexcept>
+
+#include "PipelinedExecutor.h"
+
+/*
+Constructor.
+*/
+template <typename DynamicsT, typename ControllerT>
+PipelinedExecutor<DynamicsT, ControllerT>::PipelinedExecutor(const std::vector<DynamicsT *> &_plants, 
+	const std::vector<ControllerT *> &_controllers, std::size_t _queue_capacity)
+{
+	if (_plants.size() != _controllers.size())
+		throw std::invalid_argument("Every plant needs a controller");
+	plants = _plants;
+	controllers = _controllers;
+	queue_capacity = _queue_capacity;
+}
+
+/*
+Run the given number of time steps of every loop.
+*/
+template <typename DynamicsT, typename ControllerT>
+PipelineStats PipelinedExecutor<DynamicsT, ControllerT>::run(unsigned steps)
+{
+	PipelineStats stats = {0, {0, 0, 0}, 0};
+	const unsigned loops = plants.size();
+	if (loops == 0 || steps == 0)
+		return stats;
+
+	ready = std::make_unique<BoundedQueue<unsigned>>(loops); // never full, so the feedback from the last stage cannot block
+	queue_x = std::make_unique<BoundedQueue<Token>>(queue_capacity);
+	queue_u = std::make_unique<BoundedQueue<Token>>(queue_capacity);
+	error = nullptr;
+	for (int s=0; s<num_stages_; s++)
+		busy_seconds[s] = 0;
+	for (unsigned l=0; l<loops; l++)
+		ready->push(l);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread encrypt_thread(&PipelinedExecutor::encrypt_stage, this);
+	std::thread evaluate_thread(&PipelinedExecutor::evaluate_stage, this);
+	decrypt_stage(steps);
+	encrypt_thread.join();
+	evaluate_thread.join();
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (error)
+		std::rethrow_exception(error);
+	for (int s=0; s<num_stages_; s++)
+		stats.busy_seconds[s] = busy_seconds[s];
+	stats.steps = static_cast<std::uint64_t>(loops) * steps;
+	return stats;
+}
+
+/*
+First stage: encode and encrypt the state of the next ready loop.
+*/
+template <typename DynamicsT, typename ControllerT>
+void PipelinedExecutor<DynamicsT, ControllerT>::encrypt_stage()
+{
+	try
+	{
+		unsigned loop;
+		while (ready->pop(loop))
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			Token token = {loop, &plants[loop]->return_state()};
+			busy_seconds[static_cast<int>(Stage::encrypt)] += 
+				std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (!queue_x->push(token))
+				break;
+		}
+	}
+	catch(...)
+	{
+		fail();
+	}
+}
+
+/*
+Second stage: evaluate the control law on the encrypted state.
+*/
+template <typename DynamicsT, typename ControllerT>
+void PipelinedExecutor<DynamicsT, ControllerT>::evaluate_stage()
+{
+	try
+	{
+		Token token;
+		while (queue_x->pop(token))
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			token.encrypted = &controllers[token.loop]->update_control(*token.encrypted);
+			busy_seconds[static_cast<int>(Stage::evaluate)] += 
+				std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (!queue_u->push(token))
+				break;
+		}
+	}
+	catch(...)
+	{
+		fail();
+	}
+}
+
+/*
+Last stage: decrypt the control input and update the state, then hand the loop back to the first stage until it has run 
+all its time steps. Closes the queues once every loop is done.
+*/
+template <typename DynamicsT, typename ControllerT>
+void PipelinedExecutor<DynamicsT, ControllerT>::decrypt_stage(unsigned steps)
+{
+	try
+	{
+		std::vector<unsigned> done(plants.size(), 0);
+		std::uint64_t remaining = static_cast<std::uint64_t>(plants.size()) * steps;
+		Token token;
+		while (remaining > 0 && queue_u->pop(token))
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			plants[token.loop]->get_control(*token.encrypted);
+			busy_seconds[static_cast<int>(Stage::decrypt)] += 
+				std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			remaining--;
+			if (++done[token.loop] < steps)
+				ready->push(token.loop);
+		}
+		close_queues();
+	}
+	catch(...)
+	{
+		fail();
+	}
+}
+
+/*
+Record the error of a stage and stop the other stages.
+*/
+template <typename DynamicsT, typename ControllerT>
+void PipelinedExecutor<DynamicsT, ControllerT>::fail()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (!error)
+			error = std::current_exception();
+	}
+	close_queues();
+}
+
+/*
+Close all queues, which makes the stages exit.
+*/
+template <typename DynamicsT, typename ControllerT>
+void PipelinedExecutor<DynamicsT, ControllerT>::close_queues()
+{
+	ready->close();
+	queue_x->close();
+	queue_u->close();
+}
+
+#endif
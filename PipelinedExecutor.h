@@ -0,0 +1,83 @@
+#ifndef __PIPELINEDEXECUTOR_H
+#define __PIPELINEDEXECUTOR_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <exception>
+#include <cstdint>
+
+#include "seal/seal.h"
+#include "BoundedQueue.h"
+
+/*
+Stages of the pipelined control loop.
+*/
+enum class Stage { encrypt, evaluate, decrypt, num_stages };
+const int num_stages_ = static_cast<int>(Stage::num_stages);
+
+/*
+Wall-clock time of a run, time that each stage thread spent working, and number of completed time steps.
+*/
+struct PipelineStats
+{
+	double seconds;
+	double busy_seconds[num_stages_];
+	std::uint64_t steps;
+};
+
+/*
+Executor that runs the control loops of several independent plants as a pipeline with one thread per stage: the plant 
+side encodes and encrypts the state (return_state), the controller evaluates (update_control), and the plant side 
+decrypts and updates the state (get_control). The stages are connected by bounded queues. A single loop cannot overlap 
+with itself, because x[k+1] needs u[k], but while the controller evaluates step k of one loop, the plant side encrypts 
+the state of another loop and decrypts the control input of a third, so the throughput is set by the slowest stage 
+rather than by the sum of the stage latencies. The encryptions of zero for the next step of the same loop are produced 
+in the background by the pools of Dynamics and Controller, if set.
+
+Each loop has at most one time step in flight, so the stages pass references to the ciphertext buffers owned by 
+Dynamics and Controller instead of copies.
+*/
+template <typename DynamicsT, typename ControllerT> class PipelinedExecutor {
+private:
+	struct Token
+	{
+		unsigned loop;
+		const std::vector<seal::Ciphertext> *encrypted;
+	};
+
+	std::vector<DynamicsT *> plants;
+	std::vector<ControllerT *> controllers;
+	std::size_t queue_capacity;
+
+	std::unique_ptr<BoundedQueue<unsigned>> ready; // Loops whose next time step can start.
+	std::unique_ptr<BoundedQueue<Token>> queue_x; // Encrypted states, from the plants to the controllers.
+	std::unique_ptr<BoundedQueue<Token>> queue_u; // Encrypted control inputs, from the controllers to the plants.
+	std::mutex mtx;
+	std::exception_ptr error;
+	double busy_seconds[num_stages_];
+
+	void encrypt_stage();
+	void evaluate_stage();
+	void decrypt_stage(unsigned steps);
+	void fail();
+	void close_queues();
+
+public:
+	/*
+	Constructor: loop l is plants[l] with controllers[l]. Neither is owned by the executor.
+	*/
+	PipelinedExecutor(const std::vector<DynamicsT *> &_plants, const std::vector<ControllerT *> &_controllers, 
+		std::size_t _queue_capacity = 2);
+
+	/*
+	Run the given number of time steps of every loop, and block until they are done. Rethrows the first error of a stage.
+	*/
+	PipelineStats run(unsigned steps);
+
+};
+
+#include "PipelinedExecutor.cpp"
+
+#endif
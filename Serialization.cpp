@@ -0,0 +1,242 @@
+#ifndef __SERIALIZATION_CPP
+#define __SERIALIZATION_CPP
+
+#include <sstream>
+#include <stdexcept>
+
+#include "Serialization.h"
+
+using namespace std;
+using namespace seal;
+
+
+/*
+Little-endian encoding of the header fields.
+*/
+void put_le(char *buffer, uint64_t value, size_t bytes)
+{
+	for (size_t b=0; b<bytes; b++)
+	{
+		buffer[b] = static_cast<char>((value >> (8 * b)) & 0xff);
+	}
+}
+
+uint64_t get_le(const char *buffer, size_t bytes)
+{
+	uint64_t value = 0;
+	for (size_t b=0; b<bytes; b++)
+	{
+		value |= static_cast<uint64_t>(static_cast<unsigned char>(buffer[b])) << (8 * b);
+	}
+	return value;
+}
+
+/*
+Write a header to a buffer.
+*/
+void write_wire_header(const WireHeader &header, char *buffer)
+{
+	put_le(buffer, header.magic, 4);
+	put_le(buffer + 4, header.version, 2);
+	put_le(buffer + 6, static_cast<uint16_t>(header.type), 2);
+	put_le(buffer + 8, header.count, 4);
+	put_le(buffer + 12, header.payload_bytes, 8);
+}
+
+/*
+Read and validate a header from a buffer.
+*/
+WireHeader read_wire_header(const char *buffer)
+{
+	WireHeader header;
+	header.magic = get_le(buffer, 4);
+	header.version = get_le(buffer + 4, 2);
+	header.type = static_cast<WireType>(get_le(buffer + 6, 2));
+	header.count = get_le(buffer + 8, 4);
+	header.payload_bytes = get_le(buffer + 12, 8);
+	if (header.magic != wire_magic)
+		throw runtime_error("Not a wire message");
+	if (header.version != wire_version)
+		throw runtime_error("Unsupported wire version");
+	return header;
+}
+
+/*
+Start a message: reserve the header, which is filled in by finish_message once the payload is written.
+*/
+static void start_message(ostringstream &stream)
+{
+	stream.write(string(wire_header_size, '\0').data(), wire_header_size);
+}
+
+static string finish_message(ostringstream &stream, WireType type, uint32_t count)
+{
+	string message = stream.str();
+	WireHeader header = {wire_magic, wire_version, type, count, message.size() - wire_header_size};
+	write_wire_header(header, &message[0]);
+	return message;
+}
+
+/*
+Stream buffer over a message in memory, so that the SEAL load functions read the payload in place.
+*/
+class MemoryStreambuf : public std::streambuf {
+public:
+	MemoryStreambuf(const char *data, size_t size)
+	{
+		char *begin = const_cast<char *>(data);
+		setg(begin, begin, begin + size);
+	}
+};
+
+/*
+Open a message of the expected type: validate its header and return the payload.
+*/
+static string_view open_message(string_view message, WireType type, uint32_t &count)
+{
+	if (message.size() < wire_header_size)
+		throw runtime_error("Truncated wire message");
+	WireHeader header = read_wire_header(message.data());
+	if (header.type != type)
+		throw runtime_error("Unexpected wire message type");
+	if (header.payload_bytes != message.size() - wire_header_size)
+		throw runtime_error("Truncated wire message");
+	count = header.count;
+	return message.substr(wire_header_size);
+}
+
+/*
+Serialize a vector of ciphertexts.
+*/
+void serialize_ciphertexts(const vector<Ciphertext> &encrypted, string &message)
+{
+	ostringstream stream;
+	start_message(stream);
+	for (size_t i=0; i<encrypted.size(); i++)
+	{
+		encrypted[i].save(stream);
+	}
+	message = finish_message(stream, WireType::ciphertexts, encrypted.size());
+}
+
+/*
+Deserialize a vector of ciphertexts.
+*/
+void deserialize_ciphertexts(const shared_ptr<SEALContext> &context, string_view message, vector<Ciphertext> &encrypted)
+{
+	uint32_t count;
+	string_view payload = open_message(message, WireType::ciphertexts, count);
+	const size_t min_ciphertext_bytes = 2 * context->context_data()->parms().poly_modulus_degree() * sizeof(uint64_t);
+	if (count > payload.size() / min_ciphertext_bytes)
+		throw runtime_error("Wire message holds fewer bytes than its ciphertexts need");
+	MemoryStreambuf buffer(payload.data(), payload.size());
+	istream stream(&buffer);
+	encrypted.resize(count);
+	for (uint32_t i=0; i<count; i++)
+	{
+		encrypted[i].load(context, stream);
+	}
+}
+
+/*
+Serialize and deserialize a single SEAL object with save(ostream) and load(context, istream).
+*/
+template <typename T>
+static string serialize_object(const T &object, WireType type)
+{
+	ostringstream stream;
+	start_message(stream);
+	object.save(stream);
+	return finish_message(stream, type, 1);
+}
+
+template <typename T>
+static T deserialize_object(const shared_ptr<SEALContext> &context, string_view message, WireType type)
+{
+	uint32_t count;
+	string_view payload = open_message(message, type, count);
+	MemoryStreambuf buffer(payload.data(), payload.size());
+	istream stream(&buffer);
+	T object;
+	object.load(context, stream);
+	return object;
+}
+
+/*
+Largest message for the parameters, with 4 KB per object for the headers of the SEAL save functions.
+*/
+uint64_t max_wire_message_bytes(const EncryptionParameters &parms, int decomposition_bit_count, size_t galois_key_count, 
+	size_t ciphertext_count)
+{
+	const uint64_t poly_bytes = parms.poly_modulus_degree() * parms.coeff_modulus().size() * sizeof(uint64_t);
+	uint64_t digits = 0;
+	for (size_t i=0; i<parms.coeff_modulus().size(); i++)
+	{
+		digits += (parms.coeff_modulus()[i].bit_count() + decomposition_bit_count - 1) / decomposition_bit_count;
+	}
+	const uint64_t key_bytes = max<size_t>(galois_key_count, 1) * (digits * (2 * poly_bytes + 4096));
+	const uint64_t ciphertext_bytes = ciphertext_count * (3 * poly_bytes + 4096);
+	return 4 * (wire_header_size + max(key_bytes, ciphertext_bytes));
+}
+
+string serialize_public_key(const PublicKey &public_key)
+{
+	return serialize_object(public_key, WireType::public_key);
+}
+
+PublicKey deserialize_public_key(const shared_ptr<SEALContext> &context, string_view message)
+{
+	return deserialize_object<PublicKey>(context, message, WireType::public_key);
+}
+
+string serialize_relin_keys(const RelinKeys &relin_keys)
+{
+	return serialize_object(relin_keys, WireType::relin_keys);
+}
+
+RelinKeys deserialize_relin_keys(const shared_ptr<SEALContext> &context, string_view message)
+{
+	return deserialize_object<RelinKeys>(context, message, WireType::relin_keys);
+}
+
+string serialize_galois_keys(const GaloisKeys &galois_keys)
+{
+	return serialize_object(galois_keys, WireType::galois_keys);
+}
+
+GaloisKeys deserialize_galois_keys(const shared_ptr<SEALContext> &context, string_view message)
+{
+	return deserialize_object<GaloisKeys>(context, message, WireType::galois_keys);
+}
+
+string serialize_secret_key(const SecretKey &secret_key)
+{
+	return serialize_object(secret_key, WireType::secret_key);
+}
+
+SecretKey deserialize_secret_key(const shared_ptr<SEALContext> &context, string_view message)
+{
+	return deserialize_object<SecretKey>(context, message, WireType::secret_key);
+}
+
+/*
+Serialize and deserialize the encryption parameters.
+*/
+string serialize_parameters(const EncryptionParameters &parms)
+{
+	ostringstream stream;
+	start_message(stream);
+	EncryptionParameters::Save(parms, stream);
+	return finish_message(stream, WireType::parameters, 1);
+}
+
+EncryptionParameters deserialize_parameters(string_view message)
+{
+	uint32_t count;
+	string_view payload = open_message(message, WireType::parameters, count);
+	MemoryStreambuf buffer(payload.data(), payload.size());
+	istream stream(&buffer);
+	return EncryptionParameters::Load(stream);
+}
+
+#endif
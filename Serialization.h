@@ -0,0 +1,94 @@
+#ifndef __SERIALIZATION_H
+#define __SERIALIZATION_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+
+#include "seal/seal.h"
+
+/*
+Binary wire format for the objects exchanged between the plant and the controller. Every message is a fixed-size header 
+followed by the output of the SEAL save functions for each object:
+
+	magic (4 bytes) | version (2 bytes) | type (2 bytes) | count (4 bytes) | payload bytes (8 bytes) | payload
+
+All header fields are little-endian. The payload size in the header lets a transport read a whole message without parsing 
+the payload.
+*/
+enum class WireType : std::uint16_t { ciphertexts = 1, public_key, relin_keys, galois_keys, parameters, secret_key };
+
+const std::uint32_t wire_magic = 0x4c544345; // "ECTL"
+const std::uint16_t wire_version = 1;
+const std::size_t wire_header_size = 20;
+
+struct WireHeader
+{
+	std::uint32_t magic;
+	std::uint16_t version;
+	WireType type;
+	std::uint32_t count; // Number of objects in the payload.
+	std::uint64_t payload_bytes;
+};
+
+/*
+Little-endian encoding of an integer in the given number of bytes, as in the header.
+*/
+void put_le(char *buffer, std::uint64_t value, std::size_t bytes);
+std::uint64_t get_le(const char *buffer, std::size_t bytes);
+
+/*
+Write a header to, or read and validate a header from, the first wire_header_size bytes of a buffer. Reading throws if the 
+magic number or the version do not match.
+*/
+void write_wire_header(const WireHeader &header, char *buffer);
+WireHeader read_wire_header(const char *buffer);
+
+/*
+Serialize a vector of ciphertexts into a message, and deserialize a message into a vector of ciphertexts, which are 
+checked to be valid for the context. The message and the result buffers can be reused across time steps. The deserialize 
+functions read the message in place, from a string or from a view of, e.g., a memory-mapped file. The number of 
+ciphertexts in the header is checked against the payload size before the result is resized, since the peer may not be 
+trusted.
+*/
+void serialize_ciphertexts(const std::vector<seal::Ciphertext> &encrypted, std::string &message);
+void deserialize_ciphertexts(const std::shared_ptr<seal::SEALContext> &context, std::string_view message, 
+	std::vector<seal::Ciphertext> &encrypted);
+
+/*
+Serialize and deserialize the keys that the controller needs: the public key, the relinearization keys and the Galois 
+keys.
+*/
+std::string serialize_public_key(const seal::PublicKey &public_key);
+seal::PublicKey deserialize_public_key(const std::shared_ptr<seal::SEALContext> &context, std::string_view message);
+std::string serialize_relin_keys(const seal::RelinKeys &relin_keys);
+seal::RelinKeys deserialize_relin_keys(const std::shared_ptr<seal::SEALContext> &context, std::string_view message);
+std::string serialize_galois_keys(const seal::GaloisKeys &galois_keys);
+seal::GaloisKeys deserialize_galois_keys(const std::shared_ptr<seal::SEALContext> &context, std::string_view message);
+
+/*
+Serialize and deserialize the secret key, which never leaves the plant: only for its own storage, e.g., KeyCache.
+*/
+std::string serialize_secret_key(const seal::SecretKey &secret_key);
+seal::SecretKey deserialize_secret_key(const std::shared_ptr<seal::SEALContext> &context, std::string_view message);
+
+/*
+Largest message that a peer has to accept for the parameters: a few times the largest object that is exchanged, either 
+Galois keys for galois_key_count rotations (or the relinearization keys, which are one such key), or ciphertext_count 
+ciphertexts of size up to 3. A key-switching key holds ceil(bits/decomposition_bit_count) ciphertexts of size 2 for 
+every prime of the coefficient modulus.
+*/
+std::uint64_t max_wire_message_bytes(const seal::EncryptionParameters &parms, int decomposition_bit_count, 
+	std::size_t galois_key_count, std::size_t ciphertext_count);
+
+/*
+Serialize and deserialize the encryption parameters, from which the controller creates its context.
+*/
+std::string serialize_parameters(const seal::EncryptionParameters &parms);
+seal::EncryptionParameters deserialize_parameters(std::string_view message);
+
+#include "Serialization.cpp"
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef __SHAREDMEMORYRING_CPP
+#define __SHAREDMEMORYRING_CPP
+
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "SharedMemoryRing.h"
+
+using namespace std;
+using namespace seal;
+
+/*
+Words of the record that precedes the data of each ciphertext in a slot: parms_id (4 words), size, number of data words, 
+NTT form, scale.
+*/
+static const size_t ring_record_words = 8;
+
+
+/*
+Constructor: create and map the shared region.
+*/
+SharedMemoryRing::SharedMemoryRing(size_t _slot_count, size_t _slot_bytes)
+{
+	uint64_t slot_count = 1;
+	while (slot_count < _slot_count)
+		slot_count <<= 1;
+	slot_bytes = (_slot_bytes + 63) / 64 * 64;
+	size_t bytes = sizeof(Control) + slot_count * slot_bytes;
+#ifdef __linux__
+	fd = memfd_create("encrypted_controller_ring", 0);
+#else
+	string name = "/encrypted_controller_ring_" + to_string(getpid()) + "_" + to_string(reinterpret_cast<uintptr_t>(this));
+	fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0)
+		shm_unlink(name.c_str());
+#endif
+	if (fd < 0)
+		throw runtime_error(string("Cannot create the shared memory region: ") + strerror(errno));
+	if (ftruncate(fd, bytes) != 0)
+	{
+		close(fd);
+		throw runtime_error(string("Cannot size the shared memory region: ") + strerror(errno));
+	}
+	map(bytes);
+	new (control) Control();
+	control->head.store(0, memory_order_relaxed);
+	control->tail.store(0, memory_order_relaxed);
+	control->closed.store(0, memory_order_relaxed);
+	control->slot_count = slot_count;
+	control->slot_bytes = slot_bytes;
+	mask = slot_count - 1;
+}
+
+/*
+Constructor: map the region of another process.
+*/
+SharedMemoryRing::SharedMemoryRing(int _fd)
+{
+	fd = dup(_fd);
+	struct stat status;
+	if (fd < 0 || fstat(fd, &status) != 0)
+		throw runtime_error(string("Cannot open the shared memory region: ") + strerror(errno));
+	if (static_cast<size_t>(status.st_size) < sizeof(Control))
+	{
+		close(fd);
+		throw runtime_error("The shared memory region is too small for a ring");
+	}
+	map(status.st_size);
+	const uint64_t slot_count = control->slot_count;
+	slot_bytes = control->slot_bytes;
+	const uint64_t data_bytes = mapped_bytes - sizeof(Control);
+	if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 || slot_bytes == 0 || slot_bytes % sizeof(uint64_t) != 0 
+		|| slot_count > data_bytes / slot_bytes)
+	{
+		munmap(control, mapped_bytes);
+		close(fd);
+		throw runtime_error("The shared memory region does not match the size of its ring");
+	}
+	mask = slot_count - 1;
+}
+
+/*
+Destructor: unmap the region, which is freed with its last mapping.
+*/
+SharedMemoryRing::~SharedMemoryRing()
+{
+	munmap(control, mapped_bytes);
+	close(fd);
+}
+
+/*
+Map the region.
+*/
+void SharedMemoryRing::map(size_t bytes)
+{
+	void *address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (address == MAP_FAILED)
+	{
+		close(fd);
+		throw runtime_error(string("Cannot map the shared memory region: ") + strerror(errno));
+	}
+	mapped_bytes = bytes;
+	control = static_cast<Control *>(address);
+	slots = static_cast<char *>(address) + sizeof(Control);
+}
+
+/*
+Get the start of a slot.
+*/
+uint64_t *SharedMemoryRing::slot(uint64_t index)
+{
+	return reinterpret_cast<uint64_t *>(slots + (index & mask) * slot_bytes);
+}
+
+/*
+Size of a message in a slot: the number of ciphertexts, then a record and the data of each.
+*/
+size_t SharedMemoryRing::message_bytes(const vector<Ciphertext> &encrypted)
+{
+	size_t words = 1;
+	for (size_t i=0; i<encrypted.size(); i++)
+	{
+		words += ring_record_words + encrypted[i].uint64_count();
+	}
+	return words * sizeof(uint64_t);
+}
+
+/*
+Write a message, if there is a free slot.
+*/
+bool SharedMemoryRing::try_push(const vector<Ciphertext> &encrypted)
+{
+	if (message_bytes(encrypted) > slot_bytes)
+		throw invalid_argument("Message does not fit in a slot");
+	uint64_t t = control->tail.load(memory_order_relaxed);
+	if (t - control->head.load(memory_order_acquire) > mask)
+		return false;
+	uint64_t *words = slot(t);
+	*words++ = encrypted.size();
+	for (size_t i=0; i<encrypted.size(); i++)
+	{
+		const Ciphertext &c = encrypted[i];
+		memcpy(words, c.parms_id().data(), 4 * sizeof(uint64_t));
+		words[4] = c.size();
+		words[5] = c.uint64_count();
+		words[6] = c.is_ntt_form();
+		memcpy(&words[7], &c.scale(), sizeof(double));
+		words += ring_record_words;
+		memcpy(words, c.data(), c.uint64_count() * sizeof(uint64_t));
+		words += c.uint64_count();
+	}
+	control->tail.store(t + 1, memory_order_release);
+	return true;
+}
+
+/*
+Write a message, waiting for a free slot.
+*/
+void SharedMemoryRing::push(const vector<Ciphertext> &encrypted)
+{
+	while (!try_push(encrypted))
+	{
+		if (is_closed())
+			throw runtime_error("The ring was closed by the other side");
+		this_thread::yield();
+	}
+}
+
+/*
+Read the oldest message, if there is one. The counts in the slot are read once and checked against the end of the slot 
+before anything is allocated or copied.
+*/
+bool SharedMemoryRing::try_pop(const shared_ptr<SEALContext> &context, vector<Ciphertext> &encrypted)
+{
+	uint64_t h = control->head.load(memory_order_relaxed);
+	if (h == control->tail.load(memory_order_acquire))
+		return false;
+	const uint64_t *words = slot(h);
+	const uint64_t *end = words + slot_bytes / sizeof(uint64_t);
+	const uint64_t count = *words++;
+	if (count > static_cast<uint64_t>(end - words) / ring_record_words)
+		throw runtime_error("Message in the ring does not fit in its slot");
+	encrypted.resize(count);
+	for (size_t i=0; i<encrypted.size(); i++)
+	{
+		Ciphertext &c = encrypted[i];
+		if (static_cast<uint64_t>(end - words) < ring_record_words)
+			throw runtime_error("Message in the ring does not fit in its slot");
+		parms_id_type parms_id;
+		memcpy(parms_id.data(), words, 4 * sizeof(uint64_t));
+		const uint64_t size = words[4];
+		const uint64_t uint64_count = words[5];
+		if (uint64_count > static_cast<uint64_t>(end - words) - ring_record_words)
+			throw runtime_error("Message in the ring does not fit in its slot");
+		c.resize(context, parms_id, size);
+		if (c.uint64_count() != uint64_count)
+			throw runtime_error("Ciphertext in the ring does not match the context");
+		c.is_ntt_form() = words[6];
+		memcpy(&c.scale(), &words[7], sizeof(double));
+		words += ring_record_words;
+		memcpy(c.data(), words, uint64_count * sizeof(uint64_t));
+		words += uint64_count;
+		if (!c.is_valid_for(context))
+			throw runtime_error("Ciphertext in the ring is not valid for the context");
+		if (c.is_ntt_form() != (context->context_data(c.parms_id())->parms().scheme() == scheme_type::CKKS))
+			throw runtime_error("Ciphertext in the ring is not in the NTT form of its scheme");
+	}
+	control->head.store(h + 1, memory_order_release);
+	return true;
+}
+
+/*
+Read the oldest message, waiting for one.
+*/
+void SharedMemoryRing::pop(const shared_ptr<SEALContext> &context, vector<Ciphertext> &encrypted)
+{
+	while (!try_pop(context, encrypted))
+	{
+		if (is_closed())
+			throw runtime_error("The ring was closed by the other side");
+		this_thread::yield();
+	}
+}
+
+/*
+Close the ring, for both sides.
+*/
+void SharedMemoryRing::set_closed()
+{
+	control->closed.store(1, memory_order_release);
+}
+
+bool SharedMemoryRing::is_closed() const
+{
+	return control->closed.load(memory_order_acquire) != 0;
+}
+
+/*
+Get the file descriptor of the shared region.
+*/
+int SharedMemoryRing::get_fd() const
+{
+	return fd;
+}
+
+#endif
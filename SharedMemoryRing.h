@@ -0,0 +1,92 @@
+#ifndef __SHAREDMEMORYRING_H
+#define __SHAREDMEMORYRING_H
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include "seal/seal.h"
+
+/*
+Ring of ciphertext vectors in shared memory, for a plant and a controller on the same machine. The region is an anonymous 
+memfd mapped with mmap, so another process can map it from the file descriptor, e.g., after fork. The ring is lock-free 
+with a single producer and a single consumer: each slot holds one message, i.e., one vector of ciphertexts, whose 
+coefficient data is copied straight from the ciphertexts of the producer into the slot, and from the slot into 
+preallocated ciphertexts of the consumer. SEAL ciphertexts cannot wrap external memory, so this one copy on each side is 
+the least possible, and there is no serialization and no system call per message.
+*/
+class SharedMemoryRing {
+private:
+	struct Control
+	{
+		alignas(64) std::atomic<std::uint64_t> head; // Next slot to read, written by the consumer.
+		alignas(64) std::atomic<std::uint64_t> tail; // Next slot to write, written by the producer.
+		alignas(64) std::atomic<std::uint32_t> closed; // Set by either side to stop the waits of the other.
+		alignas(64) std::uint64_t slot_count;
+		std::uint64_t slot_bytes;
+	};
+
+	int fd;
+	std::size_t mapped_bytes;
+	Control *control;
+	char *slots;
+	std::uint64_t mask;
+	std::uint64_t slot_bytes; // Copy of the slot size, which the peer cannot change after the checks.
+
+	void map(std::size_t bytes);
+	std::uint64_t *slot(std::uint64_t index);
+
+public:
+	/*
+	Create a ring with room for slot_count messages of up to slot_bytes bytes each. slot_count is rounded up to a power 
+	of 2.
+	*/
+	SharedMemoryRing(std::size_t _slot_count, std::size_t _slot_bytes);
+
+	/*
+	Map the ring of another process, from its file descriptor. Throws if the size of the region does not match the ring 
+	that it claims to hold.
+	*/
+	explicit SharedMemoryRing(int _fd);
+	SharedMemoryRing(const SharedMemoryRing &) = delete;
+	SharedMemoryRing &operator=(const SharedMemoryRing &) = delete;
+	virtual ~SharedMemoryRing();
+
+	/*
+	Write a vector of ciphertexts to the next slot. try_push returns false if the ring is full, push waits for a free 
+	slot. Both throw if the message does not fit in a slot, and push throws if the ring is closed while it waits.
+	*/
+	bool try_push(const std::vector<seal::Ciphertext> &encrypted);
+	void push(const std::vector<seal::Ciphertext> &encrypted);
+
+	/*
+	Read the oldest message into a vector of ciphertexts, whose allocations are reused across calls. try_pop returns false 
+	if the ring is empty, pop waits for a message, and throws if the ring is closed while it waits. Both throw if the 
+	message does not fit in its slot or does not match the context, since the peer is not trusted: every ciphertext is 
+	checked with is_valid_for, as by Ciphertext::load, and has to be in NTT form exactly in the CKKS scheme.
+	*/
+	bool try_pop(const std::shared_ptr<seal::SEALContext> &context, std::vector<seal::Ciphertext> &encrypted);
+	void pop(const std::shared_ptr<seal::SEALContext> &context, std::vector<seal::Ciphertext> &encrypted);
+
+	/*
+	Close the ring, e.g., when one side fails, so that the waits of both sides throw instead of spinning forever.
+	*/
+	void set_closed();
+	bool is_closed() const;
+
+	/*
+	Size of a message in a slot, in bytes, e.g., to choose slot_bytes.
+	*/
+	static std::size_t message_bytes(const std::vector<seal::Ciphertext> &encrypted);
+
+	/*
+	Access the file descriptor of the shared region.
+	*/
+	int get_fd() const;
+
+};
+
+#include "SharedMemoryRing.cpp"
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef __SOCKETCHANNEL_CPP
+#define __SOCKETCHANNEL_CPP
+
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#include "SocketChannel.h"
+
+using namespace std;
+
+
+/*
+Throw an error with the description of errno.
+*/
+static void throw_socket_error(const string &what)
+{
+	throw runtime_error(what + ": " + strerror(errno));
+}
+
+/*
+Create a socket for an address and fill in the corresponding sockaddr. Returns the file descriptor.
+*/
+static int open_socket(const string &address, sockaddr_storage &storage, socklen_t &length, string &unix_path)
+{
+	memset(&storage, 0, sizeof(storage));
+	if (address.compare(0, 5, "unix:") == 0)
+	{
+		unix_path = address.substr(5);
+		sockaddr_un *addr = reinterpret_cast<sockaddr_un *>(&storage);
+		if (unix_path.size() >= sizeof(addr->sun_path))
+			throw invalid_argument("Unix socket path too long");
+		addr->sun_family = AF_UNIX;
+		strcpy(addr->sun_path, unix_path.c_str());
+		length = sizeof(sockaddr_un);
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			throw_socket_error("socket");
+		return fd;
+	}
+	if (address.compare(0, 4, "tcp:") == 0)
+	{
+		size_t colon = address.rfind(':');
+		string host = address.substr(4, colon - 4);
+		string port = address.substr(colon + 1);
+		addrinfo hints, *result;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+			throw invalid_argument("Cannot resolve " + address);
+		memcpy(&storage, result->ai_addr, result->ai_addrlen);
+		length = result->ai_addrlen;
+		freeaddrinfo(result);
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			throw_socket_error("socket");
+		return fd;
+	}
+	throw invalid_argument("Address must start with unix: or tcp:");
+}
+
+
+/*
+Constructor: connect to a listening address.
+*/
+SocketChannel::SocketChannel(const string &address, unsigned timeout_ms, uint64_t _max_message_bytes)
+{
+	bytes_sent = 0;
+	bytes_received = 0;
+	max_message_bytes = _max_message_bytes;
+	sockaddr_storage storage;
+	socklen_t length;
+	string unix_path;
+	chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+	while (true)
+	{
+		fd = open_socket(address, storage, length, unix_path);
+		if (connect(fd, reinterpret_cast<sockaddr *>(&storage), length) == 0)
+			break;
+		int error = errno;
+		close(fd);
+		errno = error;
+		if (chrono::steady_clock::now() > deadline)
+			throw_socket_error("connect to " + address);
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	if (unix_path.empty())
+	{
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // small messages, one per time step
+	}
+}
+
+/*
+Constructor: take ownership of a connected socket.
+*/
+SocketChannel::SocketChannel(int _fd, uint64_t _max_message_bytes)
+{
+	fd = _fd;
+	bytes_sent = 0;
+	bytes_received = 0;
+	max_message_bytes = _max_message_bytes;
+}
+
+/*
+Destructor: close the socket.
+*/
+SocketChannel::~SocketChannel()
+{
+	close(fd);
+}
+
+/*
+Write or read exactly size bytes.
+*/
+void SocketChannel::write_all(const char *data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t written = ::send(fd, data, size, MSG_NOSIGNAL);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			throw_socket_error("send");
+		data += written;
+		size -= written;
+	}
+}
+
+void SocketChannel::read_all(char *data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t got = recv(fd, data, size, 0);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got == 0)
+			throw runtime_error("Connection closed");
+		if (got < 0)
+			throw_socket_error("recv");
+		data += got;
+		size -= got;
+	}
+}
+
+/*
+Send a message.
+*/
+void SocketChannel::send(const string &message)
+{
+	write_all(message.data(), message.size());
+	bytes_sent += message.size();
+}
+
+/*
+Receive the next message: read the header, then as many payload bytes as it announces, up to the maximum message size.
+*/
+void SocketChannel::receive(string &message)
+{
+	message.resize(wire_header_size);
+	read_all(&message[0], wire_header_size);
+	WireHeader header = read_wire_header(message.data());
+	if (header.payload_bytes > max_message_bytes - wire_header_size)
+		throw runtime_error("Wire message larger than the maximum message size");
+	message.resize(wire_header_size + header.payload_bytes);
+	read_all(&message[wire_header_size], header.payload_bytes);
+	bytes_received += message.size();
+}
+
+void SocketChannel::set_max_message_bytes(uint64_t _max_message_bytes)
+{
+	if (_max_message_bytes < wire_header_size)
+		throw invalid_argument("the maximum message size must hold a header");
+	max_message_bytes = _max_message_bytes;
+}
+
+/*
+Get the number of bytes sent and received.
+*/
+uint64_t SocketChannel::get_bytes_sent() const
+{
+	return bytes_sent;
+}
+
+uint64_t SocketChannel::get_bytes_received() const
+{
+	return bytes_received;
+}
+
+
+/*
+Constructor: bind to an address and listen.
+*/
+SocketListener::SocketListener(const string &address)
+{
+	sockaddr_storage storage;
+	socklen_t length;
+	fd = open_socket(address, storage, length, unix_path);
+	if (!unix_path.empty())
+		unlink(unix_path.c_str());
+	else
+	{
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	}
+	if (bind(fd, reinterpret_cast<sockaddr *>(&storage), length) != 0 || listen(fd, 8) != 0)
+	{
+		int error = errno;
+		close(fd);
+		errno = error;
+		throw_socket_error("listen on " + address);
+	}
+}
+
+/*
+Destructor: close the socket and remove the socket file.
+*/
+SocketListener::~SocketListener()
+{
+	close(fd);
+	if (!unix_path.empty())
+		unlink(unix_path.c_str());
+}
+
+/*
+Accept a connection.
+*/
+unique_ptr<SocketChannel> SocketListener::accept()
+{
+	int connection = ::accept(fd, nullptr, nullptr);
+	if (connection < 0)
+		throw_socket_error("accept");
+	if (unix_path.empty())
+	{
+		int one = 1;
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	return make_unique<SocketChannel>(connection);
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __SOCKETCHANNEL_H
+#define __SOCKETCHANNEL_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "Serialization.h"
+
+/*
+Largest message that a channel accepts unless told otherwise: enough for the encryption parameters and the keys of 
+moderate parameters. Once the parameters are known, set the limit with max_wire_message_bytes.
+*/
+const std::uint64_t default_max_message_bytes = std::uint64_t(64) << 20;
+
+/*
+Connected stream socket that sends and receives whole wire messages (see Serialization.h). An address is either 
+"unix:<path>" for a Unix-domain socket or "tcp:<host>:<port>" for a TCP socket. The channel counts the bytes that go 
+through it, so that the bytes per time step of the control loop can be reported. A received header that announces more 
+than the maximum message size is rejected before anything is allocated, since the peer may not be trusted.
+*/
+class SocketChannel {
+private:
+	int fd;
+	std::uint64_t bytes_sent;
+	std::uint64_t bytes_received;
+	std::uint64_t max_message_bytes;
+
+	void write_all(const char *data, std::size_t size);
+	void read_all(char *data, std::size_t size);
+
+public:
+	/*
+	Connect to a listening address, retrying for up to timeout_ms milliseconds while the listener is not up yet.
+	*/
+	SocketChannel(const std::string &address, unsigned timeout_ms = 5000, 
+		std::uint64_t _max_message_bytes = default_max_message_bytes);
+
+	/*
+	Take ownership of a connected socket, e.g., from SocketListener::accept.
+	*/
+	explicit SocketChannel(int _fd, std::uint64_t _max_message_bytes = default_max_message_bytes);
+	SocketChannel(const SocketChannel &) = delete;
+	SocketChannel &operator=(const SocketChannel &) = delete;
+	virtual ~SocketChannel();
+
+	/*
+	Send a message, and receive the next message into a buffer that can be reused across calls. Both throw if the 
+	connection fails, and receive throws if the message is larger than the maximum message size.
+	*/
+	void send(const std::string &message);
+	void receive(std::string &message);
+
+	/*
+	Set the maximum size of a received message, header included, e.g., with max_wire_message_bytes.
+	*/
+	void set_max_message_bytes(std::uint64_t _max_message_bytes);
+
+	/*
+	Access the number of bytes sent and received so far.
+	*/
+	std::uint64_t get_bytes_sent() const;
+	std::uint64_t get_bytes_received() const;
+
+};
+
+/*
+Listening socket that accepts the connections of SocketChannel on the same kind of address. A Unix-domain socket file is 
+removed when the listener is destroyed.
+*/
+class SocketListener {
+private:
+	int fd;
+	std::string unix_path;
+
+public:
+	SocketListener(const std::string &address);
+	SocketListener(const SocketListener &) = delete;
+	SocketListener &operator=(const SocketListener &) = delete;
+	virtual ~SocketListener();
+
+	/*
+	Block until a connection arrives.
+	*/
+	std::unique_ptr<SocketChannel> accept();
+
+};
+
+#include "SocketChannel.cpp"
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __SPARSEMATRIX_CPP
+#define __SPARSEMATRIX_CPP
+
+#include <stdexcept>
+
+#include "SparseMatrix.h"
+
+
+/*
+Empty Constructor.
+*/
+template<typename T>
+SparseMatrix<T>::SparseMatrix()
+{
+	rows = 0;
+	cols = 0;
+	row_offsets.assign(1, 0);
+}
+
+/*
+Constructor: compress the entries of the pattern, row by row.
+*/
+template<typename T>
+SparseMatrix<T>::SparseMatrix(const Matrix<T>& dense, const Matrix<int>& pattern)
+{
+	if (dense.get_rows() != pattern.get_rows() || dense.get_cols() != pattern.get_cols())
+		throw std::invalid_argument("the pattern and the matrix have different dimensions");
+	rows = dense.get_rows();
+	cols = dense.get_cols();
+	row_offsets.assign(1, 0);
+	std::vector<bool> used(cols, false);
+	for (unsigned i=0; i<rows; i++)
+	{
+		for (unsigned j=0; j<cols; j++)
+		{
+			if (pattern(i,j) != 0)
+			{
+				values.push_back(dense(i,j));
+				col_indices.push_back(j);
+				used[j] = true;
+			}
+		}
+		row_offsets.push_back(values.size());
+	}
+	for (unsigned j=0; j<cols; j++)
+		if (used[j])
+			used_cols.push_back(j);
+}
+
+/*
+Destructor.
+*/
+template<typename T>
+SparseMatrix<T>::~SparseMatrix() {}
+
+/*
+Whether a row has no nonzero, in which case a product does not write its entry of the result.
+*/
+template<typename T>
+bool SparseMatrix<T>::has_empty_row() const
+{
+	for (unsigned i=0; i<rows; i++)
+		if (row_offsets[i] == row_offsets[i + 1])
+			return true;
+	return false;
+}
+
+/*
+Nonzero pattern of an integer matrix.
+*/
+Matrix<int> nonzero_pattern(const Matrix<int>& matrix)
+{
+	Matrix<int> pattern(matrix.get_rows(), matrix.get_cols(), 0);
+	for (unsigned i=0; i<matrix.get_rows(); i++)
+		for (unsigned j=0; j<matrix.get_cols(); j++)
+			pattern(i,j) = (matrix(i,j) != 0);
+	return pattern;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef __SPARSEMATRIX_H
+#define __SPARSEMATRIX_H
+
+#include <vector>
+
+#include "Matrix.h"
+
+/*
+Sparse matrix in the compressed sparse row (CSR) layout: the nonzeros of row i are entries row_offsets[i] to
+row_offsets[i+1]-1 of values, in the columns col_indices. The rows are the schedule of a matrix-vector product, i.e., which
+entries of the vector feed each entry of the result, so that the product costs one multiplication per nonzero instead of
+rows*cols. The nonzeros are given by a pattern rather than by the values, so that the values can be plaintexts or
+ciphertexts, which cannot be tested for zero.
+*/
+template <typename T> class SparseMatrix {
+private:
+	std::vector<T> values;
+	std::vector<unsigned> col_indices;
+	std::vector<unsigned> row_offsets;
+	std::vector<unsigned> used_cols; // Columns with at least one nonzero, in increasing order.
+	unsigned rows;
+	unsigned cols;
+
+public:
+	SparseMatrix();
+
+	/*
+	Keep the entries (i,j) of the dense matrix with pattern(i,j) != 0.
+	*/
+	SparseMatrix(const Matrix<T>& dense, const Matrix<int>& pattern);
+	virtual ~SparseMatrix();
+
+	/*
+	Access the nonzeros: row i holds the entries row_begin(i) to row_end(i)-1, and entry k is in column col(k).
+	*/
+	unsigned row_begin(unsigned row) const { return row_offsets[row]; }
+	unsigned row_end(unsigned row) const { return row_offsets[row + 1]; }
+	unsigned col(unsigned k) const { return col_indices[k]; }
+	const T& value(unsigned k) const { return values[k]; }
+	T& value(unsigned k) { return values[k]; }
+	const std::vector<unsigned>& get_row_offsets() const { return row_offsets; }
+	const std::vector<unsigned>& get_used_cols() const { return used_cols; }
+
+	/*
+	Access the row and column sizes, the number of nonzeros and whether a row has none.
+	*/
+	unsigned get_rows() const { return rows; }
+	unsigned get_cols() const { return cols; }
+	unsigned nnz() const { return values.size(); }
+	bool has_empty_row() const;
+
+};
+
+/*
+Nonzero pattern of an integer matrix: 1 where the entry is nonzero, 0 elsewhere.
+*/
+Matrix<int> nonzero_pattern(const Matrix<int>& matrix);
+
+#include "SparseMatrix.cpp"
+
+#endif
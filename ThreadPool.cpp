@@ -0,0 +1,131 @@
+#ifndef __THREADPOOL_CPP
+#define __THREADPOOL_CPP
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+
+/*
+Constructor: start the workers, each with its own memory pool.
+*/
+ThreadPool::ThreadPool(unsigned _num_threads)
+{
+	if (_num_threads == 0)
+		_num_threads = 1;
+	end = 0;
+	generation = 0;
+	active = 0;
+	stop = false;
+	next = 0;
+	for (unsigned w=0; w<_num_threads; w++)
+	{
+		memory_pools.push_back(seal::MemoryPoolHandle::New());
+	}
+	for (unsigned w=0; w<_num_threads; w++)
+	{
+		workers.emplace_back(&ThreadPool::worker_loop, this, w);
+	}
+}
+
+/*
+Destructor: wake up the workers and wait for them to exit.
+*/
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(mtx);
+		stop = true;
+	}
+	cv_start.notify_all();
+	for (unsigned w=0; w<workers.size(); w++)
+	{
+		workers[w].join();
+	}
+}
+
+/*
+Loop of a worker: wait for a new job and take indices until there are none left.
+*/
+void ThreadPool::worker_loop(unsigned worker)
+{
+	unsigned seen = 0;
+	while (true)
+	{
+		unsigned local_end;
+		{
+			unique_lock<mutex> lock(mtx);
+			cv_start.wait(lock, [&]{ return stop || generation != seen; });
+			if (stop)
+				return;
+			seen = generation;
+			local_end = end;
+		}
+
+		for (unsigned i = next.fetch_add(1); i < local_end; i = next.fetch_add(1))
+		{
+			try
+			{
+				job(i, worker);
+			}
+			catch(...)
+			{
+				lock_guard<mutex> lock(mtx);
+				if (!error)
+					error = current_exception();
+			}
+		}
+
+		{
+			lock_guard<mutex> lock(mtx);
+			if (--active == 0)
+				cv_done.notify_one();
+		}
+	}
+}
+
+/*
+Run func(i, worker) for every i in [begin, end) and block until all of them are done.
+*/
+void ThreadPool::parallel_for(unsigned _begin, unsigned _end, const function<void(unsigned, unsigned)> &func)
+{
+	if (_begin >= _end)
+		return;
+
+	{
+		lock_guard<mutex> lock(mtx);
+		job = func;
+		next = _begin;
+		end = _end;
+		active = workers.size();
+		error = nullptr;
+		generation++;
+	}
+	cv_start.notify_all();
+
+	{
+		unique_lock<mutex> lock(mtx);
+		cv_done.wait(lock, [&]{ return active == 0; });
+	}
+
+	if (error)
+		rethrow_exception(error);
+}
+
+/*
+Get the number of workers.
+*/
+unsigned ThreadPool::get_num_threads() const
+{
+	return workers.size();
+}
+
+/*
+Get the memory pool of a worker.
+*/
+seal::MemoryPoolHandle ThreadPool::get_memory_pool(unsigned worker) const
+{
+	return memory_pools[worker];
+}
+
+#endif
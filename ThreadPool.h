@@ -0,0 +1,56 @@
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+#include "seal/seal.h"
+
+/*
+Fixed-size pool of worker threads for the evaluation of independent jobs, e.g., the rows of a matrix-vector product.
+Each worker owns its own SEAL memory pool, so that the workers do not contend on the global memory pool.
+*/
+class ThreadPool {
+private:
+	std::vector<std::thread> workers;
+	std::vector<seal::MemoryPoolHandle> memory_pools;
+
+	std::mutex mtx;
+	std::condition_variable cv_start;
+	std::condition_variable cv_done;
+	std::function<void(unsigned, unsigned)> job;
+	std::atomic<unsigned> next;
+	unsigned end;
+	unsigned generation;
+	unsigned active;
+	bool stop;
+	std::exception_ptr error;
+
+	void worker_loop(unsigned worker);
+
+public:
+	ThreadPool(unsigned _num_threads = std::thread::hardware_concurrency());
+	virtual ~ThreadPool();
+
+	/*
+	Run func(i, worker) for every i in [begin, end) and block until all of them are done. The indices are handed out
+	dynamically, so rows with more nonzero entries do not stall the other workers.
+	*/
+	void parallel_for(unsigned _begin, unsigned _end, const std::function<void(unsigned, unsigned)> &func);
+
+	/*
+	Access the number of workers and the memory pool of each worker.
+	*/
+	unsigned get_num_threads() const;
+	seal::MemoryPoolHandle get_memory_pool(unsigned worker) const;
+
+};
+
+#include "ThreadPool.cpp"
+
+#endif
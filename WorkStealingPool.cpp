@@ -0,0 +1,159 @@
+#ifndef __WORKSTEALINGPOOL_CPP
+#define __WORKSTEALINGPOOL_CPP
+
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+thread_local WorkStealingPool *WorkStealingPool::current_pool = nullptr;
+thread_local unsigned WorkStealingPool::current_worker = 0;
+
+
+/*
+Constructor: start the workers, each with its own queue.
+*/
+WorkStealingPool::WorkStealingPool(unsigned _num_threads)
+{
+	if (_num_threads == 0)
+		_num_threads = 1;
+	queued = 0;
+	pending = 0;
+	next_queue = 0;
+	steals = 0;
+	stop = false;
+	for (unsigned w=0; w<_num_threads; w++)
+	{
+		queues.push_back(make_unique<Queue>());
+	}
+	for (unsigned w=0; w<_num_threads; w++)
+	{
+		workers.emplace_back(&WorkStealingPool::worker_loop, this, w);
+	}
+}
+
+/*
+Destructor: finish the queued jobs, then stop the workers.
+*/
+WorkStealingPool::~WorkStealingPool()
+{
+	wait_idle();
+	{
+		lock_guard<mutex> lock(mtx);
+		stop = true;
+	}
+	cv_work.notify_all();
+	for (unsigned w=0; w<workers.size(); w++)
+	{
+		workers[w].join();
+	}
+}
+
+/*
+Queue a job on the queue of the calling worker, or round-robin.
+*/
+void WorkStealingPool::submit(function<void()> job)
+{
+	unsigned q = (current_pool == this) ? current_worker : next_queue.fetch_add(1) % queues.size();
+	pending.fetch_add(1);
+	{
+		lock_guard<mutex> lock(mtx);
+		queued.fetch_add(1); // before the push, so that the count never goes below the number of queued jobs
+	}
+	{
+		lock_guard<mutex> lock(queues[q]->mtx);
+		queues[q]->jobs.push_back(move(job));
+	}
+	cv_work.notify_one();
+}
+
+/*
+Take the oldest job of the own queue, or else steal the newest job of another queue.
+*/
+bool WorkStealingPool::take(unsigned worker, function<void()> &job)
+{
+	{
+		lock_guard<mutex> lock(queues[worker]->mtx);
+		if (!queues[worker]->jobs.empty())
+		{
+			job = move(queues[worker]->jobs.front());
+			queues[worker]->jobs.pop_front();
+			queued.fetch_sub(1);
+			return true;
+		}
+	}
+	for (unsigned i=1; i<queues.size(); i++)
+	{
+		Queue &victim = *queues[(worker + i) % queues.size()];
+		lock_guard<mutex> lock(victim.mtx);
+		if (!victim.jobs.empty())
+		{
+			job = move(victim.jobs.back());
+			victim.jobs.pop_back();
+			queued.fetch_sub(1);
+			steals.fetch_add(1, memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+Loop of a worker: run jobs while there are any, sleep otherwise.
+*/
+void WorkStealingPool::worker_loop(unsigned worker)
+{
+	current_pool = this;
+	current_worker = worker;
+	function<void()> job;
+	while (true)
+	{
+		if (take(worker, job))
+		{
+			try
+			{
+				job();
+			}
+			catch(...)
+			{
+			}
+			job = nullptr;
+			if (pending.fetch_sub(1) == 1)
+			{
+				lock_guard<mutex> lock(mtx);
+				cv_idle.notify_all();
+			}
+			continue;
+		}
+		unique_lock<mutex> lock(mtx);
+		cv_work.wait(lock, [&]{ return stop || queued.load() > 0; });
+		if (stop && queued.load() == 0)
+			return;
+	}
+}
+
+/*
+Block until all submitted jobs are done.
+*/
+void WorkStealingPool::wait_idle()
+{
+	unique_lock<mutex> lock(mtx);
+	cv_idle.wait(lock, [&]{ return pending.load() == 0; });
+}
+
+/*
+Get the number of workers.
+*/
+unsigned WorkStealingPool::get_num_threads() const
+{
+	return workers.size();
+}
+
+/*
+Get the number of stolen jobs.
+*/
+uint64_t WorkStealingPool::get_steals() const
+{
+	return steals.load(memory_order_relaxed);
+}
+
+#endif
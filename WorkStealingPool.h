@@ -0,0 +1,70 @@
+#ifndef __WORKSTEALINGPOOL_H
+#define __WORKSTEALINGPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+/*
+Pool of worker threads for many small independent jobs, e.g., the update_control of many loops. Every worker has its own 
+queue: jobs submitted from outside the pool are spread round-robin over the queues, jobs submitted from a worker go to 
+its own queue. A worker runs the oldest job of its own queue first and, when its queue is empty, steals the newest job 
+of another queue, so that the cores stay busy even if the jobs have uneven lengths.
+*/
+class WorkStealingPool {
+private:
+	struct Queue
+	{
+		std::mutex mtx;
+		std::deque<std::function<void()>> jobs;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex mtx;
+	std::condition_variable cv_work;
+	std::condition_variable cv_idle;
+	std::atomic<std::size_t> queued; // Jobs waiting in the queues.
+	std::atomic<std::size_t> pending; // Jobs waiting or running.
+	std::atomic<unsigned> next_queue;
+	std::atomic<std::uint64_t> steals;
+	bool stop;
+
+	static thread_local WorkStealingPool *current_pool;
+	static thread_local unsigned current_worker;
+
+	void worker_loop(unsigned worker);
+	bool take(unsigned worker, std::function<void()> &job);
+
+public:
+	WorkStealingPool(unsigned _num_threads = std::thread::hardware_concurrency());
+	virtual ~WorkStealingPool();
+
+	/*
+	Queue a job. Exceptions thrown by a job are not propagated: a job has to report its own errors.
+	*/
+	void submit(std::function<void()> job);
+
+	/*
+	Block until all submitted jobs are done.
+	*/
+	void wait_idle();
+
+	/*
+	Access the number of workers and the number of jobs that were stolen.
+	*/
+	unsigned get_num_threads() const;
+	std::uint64_t get_steals() const;
+
+};
+
+#include "WorkStealingPool.cpp"
+
+#endif
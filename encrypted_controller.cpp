@@ -13,43 +13,73 @@
 #include "seal/seal.h"
 #include "Matrix.h"
 #include "helper.h"
+#include "EncryptedZeroPool.h"
+#include "FixedMatrix.h"
+#include "SharedMemoryRing.h"
+#include "NoiseEstimator.h"
+#include "SparseMatrix.h"
 
 using namespace std;
 using namespace seal;
 
 
 /*
-Class that simulates a linear time invariant plant: x[k+1] = A*x[k] + B*u[k].
+Class that simulates a linear time invariant plant: x[k+1] = A*x[k] + B*u[k]. The matrices are heap-backed Matrix<int> 
+(Dynamics) or, for small plants, FixedMatrix<int, n, n> and FixedMatrix<int, n, m> with compile-time dimensions 
+(FixedDynamics<n, m>), where the state update is unrolled and mismatched dimensions do not compile.
 */
-class Dynamics
+template <typename MatrixA, typename MatrixB>
+class BasicDynamics
 {
 
+public:
+    typedef typename MatrixA::input_vector state_vector; // Type of the state.
+    typedef typename MatrixB::input_vector input_vector; // Type of the control input.
+
 private:
-    vector<int> x0_, x_; // Initial state, state.
-    Matrix<int> A_, B_; // State matrix and input matrix.
-    vector<int> u_; // Control input.
+    state_vector x0_, x_; // Initial state, state.
+    MatrixA A_; // State matrix.
+    MatrixB B_; // Input matrix.
+    input_vector u_; // Control input.
 
 	std::unique_ptr<seal::IntegerEncoder> encoder_; // Encoder object.
+    std::unique_ptr<seal::BatchEncoder> batch_encoder_; // Batch encoder object, for the packed mode.
     std::unique_ptr<seal::Encryptor> encryptor_; // Encryptor object.
     std::unique_ptr<seal::Decryptor> decryptor_; // Decryptor object.
+    std::unique_ptr<seal::Evaluator> evaluator_; // Evaluator object, to add the plaintext state to an encryption of zero.
+    std::shared_ptr<seal::SEALContext> context_; // Context, kept for the pool of encryptions of zero.
+    PublicKey public_key_; // Public key, kept for the pool of encryptions of zero.
+    std::unique_ptr<EncryptedZeroPool> zero_pool_; // Pool of encryptions of zero filled offline, if set.
+    bool flag_packed_; // Flag is 0 if each element is a different ciphertext and 1 if the state is packed in the slots of one ciphertext
+    bool flag_noise_check_; // Flag is 1 if the noise budget of the control input is decrypted and logged
 
     vector<Plaintext> plain_x_;	// Plaintext state.
     vector<Ciphertext> encrypted_x_; // Ciphertext state.
     vector<Plaintext> plain_u_; // Plaintext control input.
-    vector<int> Bu; // intermediate value B*u
+    vector<Ciphertext> encrypted_u_; // Ciphertext control input, when read from a shared-memory ring.
+    typename MatrixB::output_vector Bu; // intermediate value B*u
+    vector<int> x_buffer_, u_buffer_; // State and control input as std::vector, for the encoders.
+    vector<int> budget_buffer_; // Noise budgets of the control input, when they are checked.
+    vector<int> sequence_buffer_; // Control inputs of several time steps, from a controller with a horizon.
+    Matrix<int> C_; // Output matrix, if the plant measures y = C*x instead of x.
+    vector<int> y_buffer_; // Measured output.
+    vector<Plaintext> refresh_plain_; // Buffers of the re-encryption of ciphertexts held by the controller.
+    vector<int> refresh_values_;
+    vector<Ciphertext> refresh_encrypted_;
+    vector<int> error_buffer_; // Estimation error of an encrypted estimate of the state.
 
     /*
     Update the state according to the dynamics.
     */
     void update_state()
     {
+        INSTRUMENT_PHASE(Phase::update_state);
         x_ = A_ * x_;
         Bu = B_ * u_;
         transform (x_.begin(), x_.end(), Bu.begin(), x_.begin(), std::plus<int>());
         x_ = x_;
         k_ = k_ + 1;
-        cout << "x[" << k_ <<"]: ";
-        print_vector(x_);
+        LOG_TRACE(LogEvent::state, k_, as_std_vector(x_, x_buffer_));
     }    
 
 
@@ -60,19 +90,18 @@ public:
     /*
      Constructor: initializes the system at time 0.
      */
-    Dynamics(vector<int> _x0, Matrix<int> _A, Matrix<int> _B)
+    BasicDynamics(state_vector _x0, MatrixA _A, MatrixB _B, bool _packed = false)
     {
         k_ = 0;
+        flag_packed_ = _packed;
+        flag_noise_check_ = 0;
         x0_ = _x0;
         x_ = x0_;
         A_ = _A;
         B_ = _B;
-        cout << "A: ";
-        A_.print();
-        cout << "B: ";
-        B_.print();
-        cout << "x[0]: ";
-        print_vector(x0_);
+        LOG_DEBUG("A: " << A_);
+        LOG_DEBUG("B: " << B_);
+        LOG_TRACE(LogEvent::state, 0, as_std_vector(x0_, x_buffer_));
 
     }
 
@@ -87,90 +116,583 @@ public:
 		SecretKey secret_key = _secret_key;
 		decryptor_ = make_unique<Decryptor>(_context, secret_key);
 		encoder_ = make_unique<IntegerEncoder>(_parms.plain_modulus());
+		evaluator_ = make_unique<Evaluator>(_context);
+		context_ = _context;
+		public_key_ = _public_key;
+		if (flag_packed_)
+			batch_encoder_ = make_unique<BatchEncoder>(_context);
     }
 
+    /*
+    Encrypt the state as a fresh encryption of zero plus the plaintext state, where the encryptions of zero are produced 
+    offline in a pool of the given capacity. With capacity 0, the state is encrypted online. Call after setEncryption.
+    */
+    void set_zero_pool(std::size_t capacity)
+    {
+        if (capacity > 0)
+            zero_pool_ = make_unique<EncryptedZeroPool>(context_, public_key_, capacity);
+        else
+            zero_pool_.reset();
+    }
+
+    /*
+    Measure y = C*x instead of the full state: return_state encrypts the p entries of y, e.g., for an ObserverController. 
+    An empty C restores the full-state measurement.
+    */
+    void set_output(const Matrix<int> &C)
+    {
+        if (C.get_rows() > 0 && C.get_cols() != A_.get_rows())
+            throw invalid_argument("C has the wrong number of columns");
+        C_ = C;
+    }
+
+    /*
+    Decrypt the noise budget of every control input and log it at the info level, e.g., to check the estimate of the 
+    controller. This costs about one more decryption per ciphertext, so it is off by default.
+    */
+    void set_noise_check(bool noise_check)
+    {
+        flag_noise_check_ = noise_check;
+    }
 
     /* 
     Get ciphertext of control action, decrypt it and perform the state update.
     */
-    void get_control(vector<Ciphertext> encrypted_u)
+    void get_control(const vector<Ciphertext> &encrypted_u)
     {	
-    	cout << "Noise budget in encrypted_u: ";
-    	print_noise_budget_vector(decryptor_, encrypted_u);
-        plain_u_ = decrypt_vector(decryptor_, encrypted_u);
-        u_ = decode_vector(encoder_, plain_u_);
-        cout << "u[" << k_+1 <<"]: ";
-        print_vector(u_);
+        if (flag_noise_check_)
+        {
+            noise_budget_vector(decryptor_, encrypted_u, budget_buffer_);
+            LOG_VALUES(LogLevel::info, LogEvent::noise_budget, k_+1, budget_buffer_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::decrypt);
+            decrypt_vector(decryptor_, encrypted_u, plain_u_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::decode);
+            if (flag_packed_)
+                u_buffer_ = decode_vector_packed(batch_encoder_, plain_u_[0], B_.get_cols());
+            else
+                decode_vector(encoder_, plain_u_, u_buffer_);
+            assign_vector(u_, u_buffer_);
+        }
+        LOG_TRACE(LogEvent::control_input, k_+1, u_buffer_);
         (*this).update_state();
+        INSTRUMENT_END_STEP();
+    }
+
+    /*
+    Get the ciphertexts of the control inputs of several time steps, u[k], ..., u[k+H-1], stacked as computed by a controller 
+    with a horizon, decrypt them at once and apply them open-loop: the state is updated H times before it is sent again. 
+    Only for the per-element layout.
+    */
+    void get_control_sequence(const vector<Ciphertext> &encrypted_u)
+    {
+        if (flag_packed_)
+            throw logic_error("control sequences are only available in the per-element layout");
+        const unsigned m = B_.get_cols();
+        if (encrypted_u.size() % m != 0)
+            throw invalid_argument("the control sequence is not a whole number of control inputs");
+        if (flag_noise_check_)
+        {
+            noise_budget_vector(decryptor_, encrypted_u, budget_buffer_);
+            LOG_VALUES(LogLevel::info, LogEvent::noise_budget, k_+1, budget_buffer_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::decrypt);
+            decrypt_vector(decryptor_, encrypted_u, plain_u_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::decode);
+            decode_vector(encoder_, plain_u_, sequence_buffer_);
+        }
+        for (unsigned h = 0; h < encrypted_u.size() / m; h++)
+        {
+            u_buffer_.assign(sequence_buffer_.begin() + h * m, sequence_buffer_.begin() + (h + 1) * m);
+            assign_vector(u_, u_buffer_);
+            LOG_TRACE(LogEvent::control_input, k_+1, u_buffer_);
+            (*this).update_state();
+        }
+        INSTRUMENT_END_STEP();
+    }
+
+    /*
+    Get the ciphertext of the control action from a shared-memory ring, decrypt it and perform the state update.
+    */
+    void get_control(SharedMemoryRing &channel_u)
+    {
+        channel_u.pop(context_, encrypted_u_);
+        (*this).get_control(encrypted_u_);
     }
 
     /* 
-    Get the curent state, encrypt it and send it to the controller.
+    Get the curent state, or the output y = C*x if set_output was called, encrypt it and send it to the controller. The 
+    plaintext and ciphertext buffers are reused across time steps.
+    */
+    const vector<Ciphertext> &return_state()
+    {
+        {
+            INSTRUMENT_PHASE(Phase::encode);
+            const vector<int> &measured = C_.get_rows() > 0 ? (y_buffer_ = C_ * as_std_vector(x_, x_buffer_)) 
+                : as_std_vector(x_, x_buffer_);
+            if (flag_packed_)
+            {
+                unsigned period = max(A_.get_rows(), B_.get_cols());
+                plain_x_.resize(1);
+                plain_x_[0] = encode_vector_packed(batch_encoder_, measured, period);
+            }
+            else
+                encode_vector(encoder_, measured, plain_x_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::encrypt);
+            if (zero_pool_)
+            {
+                encrypted_x_.resize(plain_x_.size());
+                for (int i = 0; i < plain_x_.size(); i++)
+                    zero_pool_->encrypt(plain_x_[i], encrypted_x_[i], evaluator_);
+            }
+            else
+                encrypt_vector(encryptor_, plain_x_, encrypted_x_);
+        }
+        return encrypted_x_;
+    }
+
+    /*
+    Re-encrypt ciphertexts that the controller carries over time steps, such as the state of a DynamicController: decrypt, 
+    decode, encode and encrypt afresh, which resets both their noise and the growth of their IntegerEncoder encoding. The 
+    result is written to a buffer owned by the plant. Only for the per-element layout.
+    */
+    const vector<Ciphertext> &refresh(const vector<Ciphertext> &encrypted)
+    {
+        if (flag_packed_)
+            throw logic_error("refresh is only available in the per-element layout");
+        decrypt_vector(decryptor_, encrypted, refresh_plain_);
+        decode_vector(encoder_, refresh_plain_, refresh_values_);
+        encode_vector(encoder_, refresh_values_, refresh_plain_);
+        if (zero_pool_)
+        {
+            refresh_encrypted_.resize(refresh_plain_.size());
+            for (int i = 0; i < refresh_plain_.size(); i++)
+                zero_pool_->encrypt(refresh_plain_[i], refresh_encrypted_[i], evaluator_);
+        }
+        else
+            encrypt_vector(encryptor_, refresh_plain_, refresh_encrypted_);
+        return refresh_encrypted_;
+    }
+
+    /*
+    Decrypt an encrypted estimate of the state, e.g., x_hat of an ObserverController, and log and return the estimation 
+    error x_hat - x. The plant can do this since it holds the secret key.
+    */
+    const vector<int> &estimation_error(const vector<Ciphertext> &encrypted_x_hat)
+    {
+        if (flag_packed_)
+            throw logic_error("estimation_error is only available in the per-element layout");
+        decrypt_vector(decryptor_, encrypted_x_hat, refresh_plain_);
+        decode_vector(encoder_, refresh_plain_, error_buffer_);
+        as_std_vector(x_, x_buffer_);
+        for (int i = 0; i < error_buffer_.size(); i++)
+            error_buffer_[i] -= x_buffer_[i];
+        LOG_VALUES(LogLevel::info, LogEvent::estimation_error, k_, error_buffer_);
+        return error_buffer_;
+    }
+
+    /*
+    Get the current state, encrypt it and write it to a shared-memory ring read by the controller.
+    */
+    void return_state(SharedMemoryRing &channel_x)
+    {
+        channel_x.push((*this).return_state());
+    }
+
+    /*
+    Destructor.
+    */
+    ~BasicDynamics() {}
+
+};
+
+typedef BasicDynamics<Matrix<int>, Matrix<int>> Dynamics;
+template <unsigned N, unsigned M> using FixedDynamics = BasicDynamics<FixedMatrix<int, N, N>, FixedMatrix<int, N, M>>;
+
+
+/*
+Class that simulates a fleet of identical linear time invariant plants: x_j[k+1] = A*x_j[k] + B*u_j[k] for every plant j. 
+The states are multiplexed over the slots of n ciphertexts, where slot j of ciphertext i holds entry i of the state of 
+plant j, such that a Controller in the multiplexed mode computes the control inputs of all plants at once.
+*/
+class FleetDynamics
+{
+
+private:
+    vector<vector<int>> x_; // States of the plants.
+    Matrix<int> A_, B_; // State matrix and input matrix, shared by the plants.
+    vector<vector<int>> u_; // Control inputs of the plants.
+    vector<int> Bu; // intermediate value B*u
+
+    std::unique_ptr<seal::BatchEncoder> batch_encoder_; // Batch encoder object.
+    std::unique_ptr<seal::Encryptor> encryptor_; // Encryptor object.
+    std::unique_ptr<seal::Decryptor> decryptor_; // Decryptor object.
+
+    vector<Plaintext> plain_x_; // Plaintext states.
+    vector<Ciphertext> encrypted_x_; // Ciphertext states.
+    vector<Plaintext> plain_u_; // Plaintext control inputs.
+
+    /*
+    Update the states according to the dynamics.
+    */
+    void update_state()
+    {
+        INSTRUMENT_PHASE(Phase::update_state);
+        for (int j = 0; j < x_.size(); j++)
+        {
+            x_[j] = A_ * x_[j];
+            Bu = B_ * u_[j];
+            transform (x_[j].begin(), x_[j].end(), Bu.begin(), x_[j].begin(), std::plus<int>());
+        }
+        k_ = k_ + 1;
+        LOG_TRACE(LogEvent::state, k_, x_[0]);
+    }
+
+public:
+    int k_;  // time step
+
+    /*
+     Constructor: initializes the plants at time 0.
+     */
+    FleetDynamics(vector<vector<int>> _x0, Matrix<int> _A, Matrix<int> _B)
+    {
+        k_ = 0;
+        x_ = _x0;
+        A_ = _A;
+        B_ = _B;
+        LOG_DEBUG("Fleet of " << x_.size() << " plants. A: " << A_);
+        LOG_DEBUG("B: " << B_);
+    }
+
+    /*
+    Construct the encryption objects. The plaintext modulus has to support batching.
+    */
+    void setEncryption(const EncryptionParameters &_parms, const std::shared_ptr<seal::SEALContext> _context, 
+        const PublicKey _public_key, const SecretKey _secret_key)
+    {
+        batch_encoder_ = make_unique<BatchEncoder>(_context);
+        encryptor_ = make_unique<Encryptor>(_context, _public_key);
+        decryptor_ = make_unique<Decryptor>(_context, _secret_key);
+        if (x_.size() > batch_encoder_->slot_count())
+            throw invalid_argument("More plants than slots");
+    }
+
+    /*
+    Get the ciphertexts of the control inputs of all plants, decrypt them and perform the state updates.
+    */
+    void get_control(const vector<Ciphertext> &encrypted_u)
+    {
+        {
+            INSTRUMENT_PHASE(Phase::decrypt);
+            decrypt_vector(decryptor_, encrypted_u, plain_u_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::decode);
+            decode_vector_multiplexed(batch_encoder_, plain_u_, x_.size(), u_);
+        }
+        LOG_TRACE(LogEvent::control_input, k_+1, u_[0]);
+        (*this).update_state();
+        INSTRUMENT_END_STEP();
+    }
+
+    /*
+    Get the current states, encrypt them and send them to the controller.
     */
-    vector<Ciphertext> return_state()
+    const vector<Ciphertext> &return_state()
     {
-        plain_x_ = encode_vector(encoder_, x_);
-        encrypted_x_ = encrypt_vector(encryptor_, plain_x_);
+        {
+            INSTRUMENT_PHASE(Phase::encode);
+            encode_vector_multiplexed(batch_encoder_, x_, plain_x_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::encrypt);
+            encrypt_vector(encryptor_, plain_x_, encrypted_x_);
+        }
         return encrypted_x_;
     }
 
+    /*
+    Access the states of the plants.
+    */
+    const vector<vector<int>> &get_states() const
+    {
+        return x_;
+    }
+
     /*
     Destructor.
     */
-    ~Dynamics() {}
+    ~FleetDynamics() {}
 
 };
 
 
 /*
-Class that simulates a linear controller: u[k] = K*x[k].
+Class that simulates a linear time invariant plant with real-valued A, B and state, in the CKKS scheme: the state is encoded 
+at the scale ckks_scale and packed in the slots of one ciphertext, as needed by RealController, and the control input is 
+decoded as real values. The state update is in double precision.
 */
-class Controller
+class RealDynamics
+{
+
+private:
+    vector<double> x_; // State.
+    Matrix<double> A_, B_; // State matrix and input matrix.
+    vector<double> u_; // Control input.
+    vector<double> Bu; // intermediate value B*u
+
+    std::unique_ptr<seal::CKKSEncoder> ckks_encoder_; // CKKS encoder object.
+    std::unique_ptr<seal::Encryptor> encryptor_; // Encryptor object.
+    std::unique_ptr<seal::Decryptor> decryptor_; // Decryptor object.
+
+    vector<Plaintext> plain_x_; // Plaintext state.
+    vector<Ciphertext> encrypted_x_; // Ciphertext state.
+    Plaintext plain_u_; // Plaintext control input.
+
+    /*
+    Update the state according to the dynamics.
+    */
+    void update_state()
+    {
+        INSTRUMENT_PHASE(Phase::update_state);
+        x_ = A_ * x_;
+        Bu = B_ * u_;
+        transform (x_.begin(), x_.end(), Bu.begin(), x_.begin(), std::plus<double>());
+        k_ = k_ + 1;
+        LOG_TRACE(LogEvent::state, k_, x_);
+    }
+
+public:
+    int k_;  // time step
+
+    /*
+     Constructor: initializes the system at time 0.
+     */
+    RealDynamics(vector<double> _x0, Matrix<double> _A, Matrix<double> _B)
+    {
+        k_ = 0;
+        x_ = _x0;
+        A_ = _A;
+        B_ = _B;
+        LOG_DEBUG("A: " << A_);
+        LOG_DEBUG("B: " << B_);
+        LOG_TRACE(LogEvent::state, 0, x_);
+    }
+
+    /*
+    Construct the encryption objects. The parameters are for the CKKS scheme, with at least two primes in the coefficient 
+    modulus for the rescale of K*x.
+    */
+    void setEncryption(const EncryptionParameters &_parms, const std::shared_ptr<seal::SEALContext> _context, 
+        const PublicKey _public_key, const SecretKey _secret_key)
+    {
+        ckks_encoder_ = make_unique<CKKSEncoder>(_context);
+        encryptor_ = make_unique<Encryptor>(_context, _public_key);
+        decryptor_ = make_unique<Decryptor>(_context, _secret_key);
+    }
+
+    /*
+    Get the ciphertext of the control input, decrypt it and perform the state update.
+    */
+    void get_control(const vector<Ciphertext> &encrypted_u)
+    {
+        {
+            INSTRUMENT_PHASE(Phase::decrypt);
+            decryptor_->decrypt(encrypted_u[0], plain_u_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::decode);
+            u_ = decode_vector_packed(ckks_encoder_, plain_u_, B_.get_cols());
+        }
+        LOG_TRACE(LogEvent::control_input, k_+1, u_);
+        (*this).update_state();
+        INSTRUMENT_END_STEP();
+    }
+
+    /*
+    Get the current state, encrypt it and send it to the controller.
+    */
+    const vector<Ciphertext> &return_state()
+    {
+        {
+            INSTRUMENT_PHASE(Phase::encode);
+            plain_x_.resize(1);
+            plain_x_[0] = encode_vector_packed(ckks_encoder_, x_, max(A_.get_rows(), B_.get_cols()), ckks_scale);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::encrypt);
+            encrypt_vector(encryptor_, plain_x_, encrypted_x_);
+        }
+        return encrypted_x_;
+    }
+
+    /*
+    Destructor.
+    */
+    ~RealDynamics() {}
+
+};
+
+
+/*
+Class that simulates a linear controller: u[k] = K*x[k]. The plaintext gain is a heap-backed Matrix<int> (Controller) or a 
+FixedMatrix<int, m, n> with compile-time dimensions (FixedController<m, n>).
+*/
+template <typename MatrixK>
+class BasicController
 {
 private:
     vector<int> u_; // Control input.
-    Matrix<int> K_; // Control gain matrix.
+    MatrixK K_; // Control gain matrix.
 
 	std::unique_ptr<seal::IntegerEncoder> encoder_; // Encoder object.
+    std::unique_ptr<seal::BatchEncoder> batch_encoder_; // Batch encoder object, for the packed mode.
     std::unique_ptr<seal::Encryptor> encryptor_; // Encryptor object.
 	std::unique_ptr<seal::Evaluator> evaluator_; // Evaluator object.
+    GaloisKeys galois_keys_; // Galois keys for the rotations in the packed mode.
+    RelinKeys relin_keys_; // Relinearization keys for the products of ciphertexts, if set.
+    std::unique_ptr<ThreadPool> thread_pool_; // Workers for the matrix-vector product, if set.
+    std::shared_ptr<seal::SEALContext> context_; // Context, kept for the pool of encryptions of zero.
+    PublicKey public_key_; // Public key, kept for the pool of encryptions of zero.
+    std::unique_ptr<EncryptedZeroPool> zero_pool_; // Pool of encryptions of zero filled offline, if set.
+    std::unique_ptr<NoiseEstimator> noise_estimator_; // Static estimate of the noise budget.
+    double estimated_budget_; // Estimated noise budget of the control input.
+    double refresh_threshold_; // Estimated noise budget below which the ciphertexts have to be refreshed.
 
-    Matrix<Plaintext> plain_K_;	// Plaintext control gain.
-    Matrix<Ciphertext> enc_K_; // Ciphertext control gain
+    Matrix<int> gain_; // Gain applied to the state: K, or the stacked gain of the horizon.
+    unsigned horizon_; // Number of time steps whose control inputs are computed per update_control.
+    Matrix<int> pattern_; // Nonzero pattern of the control gain, which decides the products that are evaluated.
+    SparseMatrix<Plaintext> plain_K_; // Nonzeros of the plaintext control gain.
+    Matrix<Ciphertext> dense_enc_K_; // Ciphertext control gain as given, until getEncryption compresses it.
+    SparseMatrix<Ciphertext> enc_K_; // Nonzeros of the ciphertext control gain.
+    vector<Plaintext> diag_K_; // Plaintext diagonals of the control gain, for the packed mode.
     vector<Ciphertext> encrypted_u_;  // Ciphertext control input.
+    vector<Ciphertext> encrypted_x_; // Ciphertext state, when read from a shared-memory ring.
+    vector<Plaintext> enco_zero_vector_; // Encoded zeros, to seed the accumulation of K*x.
+    Ciphertext scratch_; // Scratch ciphertext for the products.
+    vector<Ciphertext> rotations_; // Baby-step rotations of the state, for the packed mode.
+    Ciphertext accumulator_; // Accumulator of a row of K*x, for the NTT mode.
+    vector<Ciphertext> encrypted_x_ntt_; // State in NTT form, for the NTT mode.
     bool flag_enc_;	// Flag is 0 if K is plaintext and 1 if it is ciphertext
+    bool flag_packed_; // Flag is 0 if each element is a different ciphertext and 1 if the state is packed in the slots of one ciphertext
+    bool flag_ntt_; // Flag is 1 if the plaintext K is stored in NTT form
+    bool flag_multiplexed_; // Flag is 1 if slot j of ciphertext i holds entry i of plant j, for a fleet that shares K
+    bool flag_relin_; // Flag is 1 if the products with the ciphertext K are relinearized
+
+    /*
+    Set the control input to fresh encryptions of zero, taken from the pool if there is one.
+    */
+    void seed_zeros()
+    {
+        INSTRUMENT_PHASE(Phase::encrypt);
+        if (zero_pool_)
+        {
+            encrypted_u_.resize(enco_zero_vector_.size());
+            for (int i = 0; i < encrypted_u_.size(); i++)
+                zero_pool_->take(encrypted_u_[i]);
+        }
+        else
+            encrypt_vector(encryptor_, enco_zero_vector_, encrypted_u_);
+    }
+
+    /*
+    Estimate the noise budget of the control input from the budget of the state, through the operations of update_control, 
+    without the secret key. The ciphertext K is a fresh encryption.
+    */
+    double estimate_budget(double x_budget) const
+    {
+        const NoiseEstimator &estimator = *noise_estimator_;
+        const unsigned m = pattern_.get_rows();
+        const unsigned n = pattern_.get_cols();
+        if (flag_packed_)
+        {
+            const unsigned d = max(m, n);
+            const unsigned g = diagonal_baby_steps(d);
+            const unsigned giant_steps = (d + g - 1) / g;
+            double budget = estimator.add(estimator.multiply_plain_batched(g > 1 ? estimator.key_switch(x_budget) : x_budget), g);
+            return estimator.add(giant_steps > 1 ? estimator.key_switch(budget) : budget, giant_steps);
+        }
+        if (flag_enc_ == 0)
+        {
+            const Matrix<int> &K = gain_;
+            std::int64_t bound_K = 0;
+            for (int i = 0; i < m; i++)
+                for (int j = 0; j < n; j++)
+                    bound_K = max<std::int64_t>(bound_K, abs(K(i,j)));
+            double plain_norm = flag_multiplexed_ ? bound_K : NoiseEstimator::integer_plain_norm(bound_K);
+            return estimator.add(estimator.multiply_plain(x_budget, plain_norm), n);
+        }
+        double budget = estimator.add(estimator.multiply(x_budget, estimator.fresh()), n);
+        if (flag_relin_)
+            budget = estimator.key_switch(budget);
+        return estimator.mod_switch(budget);
+    }
+
+    /*
+    Refresh policy: every step starts from a fresh encryption of the state, so the budget of the control input is the same 
+    at every step and a refresh by the plant cannot raise it. Parameters whose estimate is below the threshold are rejected 
+    at setup, instead of decrypting the noise budget at every step.
+    */
+    void check_budget()
+    {
+        estimated_budget_ = estimate_budget(noise_estimator_->fresh());
+        if (estimated_budget_ < refresh_threshold_)
+            throw invalid_argument("the estimated noise budget of the control input is below the refresh threshold");
+    }
 
 public:
     int k_;  // time step
 
-    // Constructor: initializes the controller at time 0 with plaintext control gain.
-    Controller(Matrix<int> _K)
+    // Constructor: initializes the controller at time 0 with plaintext control gain. In the packed mode, K*x is computed 
+    // with the diagonal method on a single ciphertext that holds x in its slots.
+    BasicController(MatrixK _K, bool _packed = false)
     {
         k_ = 0;
         K_ = _K;
-        cout << "K: ";
-        K_.print();
+        LOG_DEBUG("K: " << K_);
+        gain_ = as_matrix(K_);
+        horizon_ = 1;
+        pattern_ = nonzero_pattern(gain_);
         const int m = K_.get_rows();
         const int n = K_.get_cols();
         vector<int> u (m, 0);
         u_ = u;
-        cout << "initialize u: ";
-        print_vector(u_);
+        LOG_TRACE(LogEvent::control_input, 0, u_);
         flag_enc_ = 0;
+        flag_packed_ = _packed;
+        flag_ntt_ = 0;
+        flag_relin_ = 0;
+        flag_multiplexed_ = 0;
+        refresh_threshold_ = refresh_threshold_bits;
     }
 
-    // Constructor: initializes the controller at time 0 with ciphertext control gain.
-    Controller(Matrix<Ciphertext> _K)
+    // Constructor: initializes the controller at time 0 with ciphertext control gain. The nonzero pattern of K, if given, 
+    // is revealed to the controller, which then skips the products with the zero entries; by default all entries are used.
+    BasicController(Matrix<Ciphertext> _K, Matrix<int> _pattern = Matrix<int>())
     {
         k_ = 0;
-        enc_K_ = _K;
+        dense_enc_K_ = _K;
+        horizon_ = 1;
+        pattern_ = _pattern.get_rows() > 0 ? _pattern : Matrix<int>(_K.get_rows(), _K.get_cols(), 1);
         const int m = _K.get_rows();
         const int n = _K.get_cols();
         vector<int> u (m, 0);
         u_ = u;
-        cout << "initialize u: ";
-        print_vector(u_);
+        LOG_TRACE(LogEvent::control_input, 0, u_);
         flag_enc_ = 1;
+        flag_packed_ = 0;
+        flag_ntt_ = 0;
+        flag_relin_ = 0;
+        flag_multiplexed_ = 0;
+        refresh_threshold_ = refresh_threshold_bits;
     }
 
     /*
@@ -181,33 +703,545 @@ public:
 		encoder_ = make_unique<IntegerEncoder>(_parms.plain_modulus());
 	    encryptor_ = make_unique<Encryptor>(_context, _public_key);
 	    evaluator_ = make_unique<Evaluator>(_context);
+	    context_ = _context;
+	    public_key_ = _public_key;
+	    noise_estimator_ = make_unique<NoiseEstimator>(_parms, decomposition_bit_count);
 
-	    if (flag_enc_ == 0)
-	    	plain_K_ = encode_matrix(encoder_, K_);	// compute the plaintext for the constant matrix once
+	    if (flag_enc_ == 0 && flag_packed_ == 0 && flag_multiplexed_)
+	    {
+	    	batch_encoder_ = make_unique<BatchEncoder>(_context);
+	    	plain_K_ = SparseMatrix<Plaintext>(encode_matrix_multiplexed(batch_encoder_, gain_), pattern_); // every entry of K in all slots
+	    	encode_vector_multiplexed(batch_encoder_, vector<vector<int>>(1, vector<int>(gain_.get_rows(), 0)), enco_zero_vector_);
+	    	if (flag_ntt_)
+	    		transform_to_ntt_matrix(evaluator_, plain_K_, _context->context_data()->parms().parms_id());
+	    }
+	    else if (flag_enc_ == 0 && flag_packed_ == 0)
+	    {
+	    	plain_K_ = SparseMatrix<Plaintext>(encode_matrix(encoder_, gain_), pattern_); // compute the nonzeros of the constant matrix once
+	    	enco_zero_vector_ = encode_vector(encoder_, vector<int>(gain_.get_rows(), 0));
+	    	if (flag_ntt_)
+	    		transform_to_ntt_matrix(evaluator_, plain_K_, _context->context_data()->parms().parms_id());
+	    }
+	    else if (flag_enc_ && dense_enc_K_.get_rows() > 0)
+	    {
+	    	enc_K_ = SparseMatrix<Ciphertext>(dense_enc_K_, pattern_);
+	    	dense_enc_K_ = Matrix<Ciphertext>();
+	    	enco_zero_vector_ = encode_vector(encoder_, vector<int>(enc_K_.get_rows(), 0)); // for the rows without nonzeros
+	    }
+	    (*this).check_budget();
     }    
 
     /*
-    Compute the control action according to the control law.
+    Initialize the encryption parameters for the packed mode, which also needs the Galois keys for the rotations.
+    */
+    void getEncryption(const EncryptionParameters _parms, const std::shared_ptr<seal::SEALContext> _context, const PublicKey _public_key, 
+        const GaloisKeys _galois_keys)
+    {
+        getEncryption(_parms, _context, _public_key);
+        galois_keys_ = _galois_keys;
+        if (flag_packed_)
+        {
+            batch_encoder_ = make_unique<BatchEncoder>(_context);
+            diag_K_ = encode_matrix_diagonals(batch_encoder_, as_matrix(K_)); // compute the diagonals of the constant matrix once
+            enco_zero_vector_.resize(1);
+            batch_encoder_->encode(vector<std::int64_t>(batch_encoder_->slot_count(), 0), enco_zero_vector_[0]);
+        }
+        (*this).check_budget();
+    }
+
+    /*
+    Initialize the encryption parameters for the ciphertext K, with relinearization keys: each row of K*x is relinearized 
+    once after its accumulation, so that encrypted_u has size 2 instead of 3.
     */
-    vector<Ciphertext> update_control(vector<Ciphertext> encrypted_x)
+    void getEncryption(const EncryptionParameters _parms, const std::shared_ptr<seal::SEALContext> _context, const PublicKey _public_key, 
+        const RelinKeys _relin_keys)
     {
-    	if (flag_enc_ == 0)
+        getEncryption(_parms, _context, _public_key);
+        relin_keys_ = _relin_keys;
+        flag_relin_ = flag_enc_;
+        (*this).check_budget();
+    }
+
+    /*
+    Set the threshold of the refresh policy, in bits of estimated noise budget. Call before getEncryption.
+    */
+    void set_refresh_threshold(double threshold)
+    {
+        refresh_threshold_ = threshold;
+    }
+
+    /*
+    Access the estimated noise budget of the control input.
+    */
+    double get_estimated_budget() const
+    {
+        return estimated_budget_;
+    }
+
+    /*
+    Store the plaintext K in NTT form and evaluate K*x in NTT form. Call before getEncryption. Only used with plaintext K in 
+    the per-element layout.
+    */
+    void set_ntt_form(bool ntt)
+    {
+        flag_ntt_ = ntt && flag_enc_ == 0 && flag_packed_ == 0;
+    }
+
+    /*
+    Compute the control inputs of horizon time steps per update_control, u[k+h] = K(A+BK)^h x[k] for h < horizon, from one 
+    encrypted state: the stacked gain [K; K(A+BK); ...; K(A+BK)^(horizon-1)] is computed once here, and the plant applies 
+    the inputs open-loop with get_control_sequence. This divides the round trips and the encryptions of the state per time 
+    step by horizon, but the inputs after the first one do not react to disturbances. The entries of the stacked gain grow 
+    with the horizon, so plan the parameters with their bound (get_gain). Call before getEncryption. Only used with 
+    plaintext K in the per-element layout.
+    */
+    void set_horizon(unsigned horizon, const Matrix<int> &A, const Matrix<int> &B)
+    {
+        horizon_ = (flag_enc_ == 0 && flag_packed_ == 0 && horizon > 1) ? horizon : 1;
+        gain_ = stack_horizon_gain(as_matrix(K_), A, B, horizon_);
+        pattern_ = nonzero_pattern(gain_);
+    }
+
+    /*
+    Access the horizon and the gain applied to the state.
+    */
+    unsigned get_horizon() const
+    {
+        return horizon_;
+    }
+
+    const Matrix<int> &get_gain() const
+    {
+        return gain_;
+    }
+
+    /*
+    Evaluate K*x for a fleet of plants that share K at once: slot j of the state ciphertext i holds entry i of the state of 
+    plant j, as produced by FleetDynamics, and K is encoded constant over the slots, so the per-element evaluation of K*x 
+    serves up to slot_count plants. Needs a plaintext modulus that supports batching. Call before getEncryption. Only used 
+    with plaintext K in the per-element layout.
+    */
+    void set_multiplexed(bool multiplexed)
+    {
+        flag_multiplexed_ = multiplexed && flag_enc_ == 0 && flag_packed_ == 0;
+    }
+
+    /*
+    Seed the accumulation of K*x with encryptions of zero produced offline in a pool of the given capacity, instead of 
+    encrypting them online. With capacity 0, they are encrypted online. Call after getEncryption.
+    */
+    void set_zero_pool(std::size_t capacity)
+    {
+        if (capacity > 0)
+            zero_pool_ = make_unique<EncryptedZeroPool>(context_, public_key_, capacity);
+        else
+            zero_pool_.reset();
+    }
+
+    /*
+    Evaluate the matrix-vector products on a pool of num_threads workers. With 0 or 1 threads, the evaluation is sequential.
+    */
+    void set_num_threads(unsigned num_threads)
+    {
+        if (num_threads > 1)
+            thread_pool_ = make_unique<ThreadPool>(num_threads);
+        else
+            thread_pool_.reset();
+    }
+
+    /*
+    Compute the control action according to the control law. The result is written to a buffer owned by the controller, 
+    which is reused across time steps.
+    */
+    const vector<Ciphertext> &update_control(const vector<Ciphertext> &encrypted_x)
+    {
+    	if (flag_packed_)
+    	{
+            (*this).seed_zeros();
+            INSTRUMENT_PHASE(Phase::evaluate);
+            mult_matrix_vector_diagonal(evaluator_, galois_keys_, diag_K_, encrypted_x[0], encrypted_u_[0], scratch_, rotations_);
+    	}
+    	else if (flag_enc_ == 0)
     	{
-	    	vector<int> zero_vector(K_.get_rows(),0);
-	    	vector<Plaintext> enco_zero_vector = encode_vector(encoder_, zero_vector);
-	    	vector<Ciphertext> encr_zero_vector = encrypt_vector(encryptor_, enco_zero_vector);
-	        encrypted_u_ = mult_matrix_vector(evaluator_, plain_K_, encrypted_x, encr_zero_vector);
+	    	(*this).seed_zeros();
+	    	INSTRUMENT_PHASE(Phase::evaluate);
+	    	if (flag_ntt_ && thread_pool_)
+	    		mult_matrix_vector_ntt(evaluator_, plain_K_, encrypted_x, encrypted_x_ntt_, encrypted_u_, *thread_pool_);
+	    	else if (flag_ntt_)
+	    		mult_matrix_vector_ntt(evaluator_, plain_K_, encrypted_x, encrypted_x_ntt_, encrypted_u_, accumulator_, scratch_);
+	    	else if (thread_pool_)
+	    		mult_matrix_vector(evaluator_, plain_K_, encrypted_x, encrypted_u_, *thread_pool_);
+	    	else
+	        	mult_matrix_vector(evaluator_, plain_K_, encrypted_x, encrypted_u_, scratch_);
     	}
     	else
     	{
-    		encrypted_u_ = mult_matrix_vector(evaluator_, enc_K_, encrypted_x);
+    		if (enc_K_.has_empty_row())
+    			(*this).seed_zeros();
+    		INSTRUMENT_PHASE(Phase::evaluate);
+    		if (thread_pool_)
+    			mult_matrix_vector(evaluator_, enc_K_, encrypted_x, encrypted_u_, *thread_pool_);
+    		else
+    			mult_matrix_vector(evaluator_, enc_K_, encrypted_x, encrypted_u_, scratch_);
+    		if (flag_relin_ && thread_pool_)
+    			relinearize_vector(evaluator_, relin_keys_, encrypted_u_, *thread_pool_);
+    		else if (flag_relin_)
+    			relinearize_vector(evaluator_, relin_keys_, encrypted_u_);
+    		mod_switch_vector(evaluator_, encrypted_u_, context_->last_parms_id()); // smallest encrypted_u to send back
     	}
+        k_ = k_ + horizon_;
+        return encrypted_u_;
+    }
+
+    /*
+    Read the ciphertext state from a shared-memory ring, compute the control action and write it to another ring read by 
+    the plant.
+    */
+    void update_control(SharedMemoryRing &channel_x, SharedMemoryRing &channel_u)
+    {
+        channel_x.pop(context_, encrypted_x_);
+        channel_u.push((*this).update_control(encrypted_x_));
+    }
+
+    // Destructor.
+    ~BasicController() {}
+
+};
+
+typedef BasicController<Matrix<int>> Controller;
+template <unsigned M, unsigned N> using FixedController = BasicController<FixedMatrix<int, M, N>>;
+
+/*
+Class that simulates a dynamic linear controller with an internal state x_c that stays encrypted across time steps:
+    x_c[k+1] = F*x_c[k] + G*y[k],
+    u[k] = H*x_c[k] + J*y[k],
+where y is the state of the plant. The gains are plaintext and are stacked into M = [H J; F G], so that one matrix-vector 
+product [u[k]; x_c[k+1]] = M*[x_c[k]; y[k]] evaluates all four gains in one pass, split over the rows on a thread pool 
+if set.
+
+The state x_c is never decrypted by the controller, so its noise and the coefficients and degree of its IntegerEncoder 
+encoding grow with every step. The controller tracks all three statically (NoiseEstimator and the plaintext modulus) and 
+requests a refresh one step before the next product could be wrong: the plant re-encrypts x_c (Dynamics::refresh), 
+which it can do along with the decryption of u, and hands it back with set_state before the next step. The refresh adds 
+no round trip, and the loop never waits for the budget to run out.
+*/
+class DynamicController
+{
+private:
+    Matrix<int> M_; // Stacked gain [H J; F G].
+    unsigned m_, p_, n_; // Number of control inputs, of controller states and of plant states.
+    vector<int> x_c0_; // Initial controller state.
+
+	std::unique_ptr<seal::IntegerEncoder> encoder_; // Encoder object.
+    std::unique_ptr<seal::Encryptor> encryptor_; // Encryptor object.
+	std::unique_ptr<seal::Evaluator> evaluator_; // Evaluator object.
+    std::unique_ptr<ThreadPool> thread_pool_; // Workers for the matrix-vector product, if set.
+    std::unique_ptr<NoiseEstimator> noise_estimator_; // Static estimate of the noise budget.
+
+    Matrix<Plaintext> plain_M_; // Plaintext stacked gain.
+    vector<Plaintext> enco_zero_vector_; // Encoded zeros, to seed the accumulation of M*z.
+    vector<Ciphertext> encrypted_z_; // Ciphertext [x_c; y]: x_c stays in the first p entries across time steps.
+    vector<Ciphertext> encrypted_w_; // Ciphertext [u; x_c[k+1]].
+    vector<Ciphertext> encrypted_u_; // Ciphertext control input.
+    vector<Ciphertext> encrypted_x_c_; // Ciphertext controller state, as handed to the plant for a refresh.
+    Ciphertext scratch_; // Scratch ciphertext for the products.
+
+    double plain_norm_; // Size of the IntegerEncoder encoding of the largest entry of M.
+    double half_plain_modulus_; // Bound on the coefficients of the encodings.
+    double refresh_threshold_; // Estimated noise budget below which x_c is refreshed.
+    double state_budget_; // Estimated noise budget of x_c.
+    double state_coeff_; // Bound on the coefficients of the encoding of x_c.
+    double state_degree_; // Bound on the degree of the encoding of x_c.
+    std::size_t poly_modulus_degree_;
+    bool refresh_requested_;
+
+    /*
+    Budget, coefficient bound and degree bound of the outputs of one step, from those of x_c. The state y of the plant is 
+    a fresh encryption of an int, whose encoding has coefficients of at most 1 and at most 32 digits.
+    */
+    void step_bounds(double budget, double coeff, double degree, double &next_budget, double &next_coeff, 
+        double &next_degree) const
+    {
+        next_budget = noise_estimator_->add(noise_estimator_->multiply_plain(min(budget, noise_estimator_->fresh()), 
+            plain_norm_), p_ + n_ + 1);
+        next_coeff = (p_ + n_) * plain_norm_ * max(coeff, 1.0);
+        next_degree = max(degree, 32.0) + plain_norm_;
+    }
+
+    /*
+    Whether one step from an x_c with these bounds gives outputs that decrypt and decode correctly.
+    */
+    bool step_fits(double budget, double coeff, double degree) const
+    {
+        double next_budget, next_coeff, next_degree;
+        step_bounds(budget, coeff, degree, next_budget, next_coeff, next_degree);
+        return next_budget >= refresh_threshold_ && next_coeff < half_plain_modulus_ && next_degree < poly_modulus_degree_;
+    }
+
+public:
+    int k_;  // time step
+
+    // Constructor: initializes the controller at time 0 with plaintext gains and the initial state x_c0 (zero if empty).
+    DynamicController(Matrix<int> _F, Matrix<int> _G, Matrix<int> _H, Matrix<int> _J, vector<int> _x_c0 = vector<int>())
+    {
+        k_ = 0;
+        p_ = _F.get_rows();
+        n_ = _G.get_cols();
+        m_ = _H.get_rows();
+        if (_F.get_cols() != p_ || _G.get_rows() != p_ || _H.get_cols() != p_ || _J.get_rows() != m_ || _J.get_cols() != n_)
+            throw invalid_argument("F, G, H and J have incompatible dimensions");
+        x_c0_ = _x_c0.empty() ? vector<int>(p_, 0) : _x_c0;
+        if (x_c0_.size() != p_)
+            throw invalid_argument("x_c0 has the wrong dimension");
+        M_ = Matrix<int>(m_ + p_, p_ + n_, 0);
+        for (int i = 0; i < m_ + p_; i++)
+            for (int j = 0; j < p_ + n_; j++)
+            {
+                if (i < m_)
+                    M_(i,j) = j < p_ ? _H(i,j) : _J(i,j - p_);
+                else
+                    M_(i,j) = j < p_ ? _F(i - m_,j) : _G(i - m_,j - p_);
+            }
+        LOG_DEBUG("[H J; F G]: " << M_);
+        refresh_threshold_ = refresh_threshold_bits;
+        refresh_requested_ = 0;
+    }
+
+    /*
+    Initialize the encryption parameters and encrypt the initial state. Throws if even a fresh x_c does not allow one 
+    correct step.
+    */
+    void getEncryption(const EncryptionParameters _parms, const std::shared_ptr<seal::SEALContext> _context, const PublicKey _public_key)
+    {
+        encoder_ = make_unique<IntegerEncoder>(_parms.plain_modulus());
+        encryptor_ = make_unique<Encryptor>(_context, _public_key);
+        evaluator_ = make_unique<Evaluator>(_context);
+        noise_estimator_ = make_unique<NoiseEstimator>(_parms, decomposition_bit_count);
+        plain_M_ = encode_matrix(encoder_, M_);
+        enco_zero_vector_ = encode_vector(encoder_, vector<int>(m_ + p_, 0));
+        std::int64_t bound_M = 0;
+        for (int i = 0; i < m_ + p_; i++)
+            for (int j = 0; j < p_ + n_; j++)
+                bound_M = max<std::int64_t>(bound_M, abs(M_(i,j)));
+        plain_norm_ = NoiseEstimator::integer_plain_norm(bound_M);
+        half_plain_modulus_ = _parms.plain_modulus().value() / 2.0;
+        poly_modulus_degree_ = _parms.poly_modulus_degree();
+        (*this).reset(x_c0_);
+        if (!step_fits(state_budget_, state_coeff_, state_degree_))
+            throw invalid_argument("the parameters do not allow one step of the dynamic controller");
+    }
+
+    /*
+    Evaluate the products on a pool of num_threads workers. With 0 or 1 threads, the evaluation is sequential.
+    */
+    void set_num_threads(unsigned num_threads)
+    {
+        if (num_threads > 1)
+            thread_pool_ = make_unique<ThreadPool>(num_threads);
+        else
+            thread_pool_.reset();
+    }
+
+    /*
+    Set the threshold of the refresh policy, in bits of estimated noise budget. Call before getEncryption.
+    */
+    void set_refresh_threshold(double threshold)
+    {
+        refresh_threshold_ = threshold;
+    }
+
+    /*
+    Reset the controller state to a plaintext value, encrypted with the public key, e.g., when the loop is restarted.
+    */
+    void reset(const vector<int> &x_c)
+    {
+        if (x_c.size() != p_)
+            throw invalid_argument("x_c has the wrong dimension");
+        encrypted_z_.resize(p_ + n_);
+        for (int i = 0; i < p_; i++)
+            encryptor_->encrypt(encoder_->encode(x_c[i]), encrypted_z_[i]);
+        state_budget_ = noise_estimator_->fresh();
+        state_coeff_ = 1;
+        state_degree_ = 32;
+        refresh_requested_ = 0;
+    }
+
+    /*
+    Compute the control input and the next controller state in one pass. The control input is written to a buffer owned 
+    by the controller, which is reused across time steps. Throws if a requested refresh was not done, since the result 
+    could be wrong, or if the plant does not send one ciphertext per column of G.
+    */
+    const vector<Ciphertext> &update_control(const vector<Ciphertext> &encrypted_y)
+    {
+        if (refresh_requested_)
+            throw runtime_error("the controller state has to be refreshed before the next step");
+        if (encrypted_y.size() != n_)
+            throw invalid_argument("Dimensions incompatible!");
+        {
+            INSTRUMENT_PHASE(Phase::encrypt);
+            encrypt_vector(encryptor_, enco_zero_vector_, encrypted_w_);
+        }
+        {
+            INSTRUMENT_PHASE(Phase::evaluate);
+            for (int j = 0; j < n_; j++)
+                encrypted_z_[p_ + j] = encrypted_y[j];
+            if (thread_pool_)
+                mult_matrix_vector(evaluator_, plain_M_, encrypted_z_, encrypted_w_, *thread_pool_);
+            else
+                mult_matrix_vector(evaluator_, plain_M_, encrypted_z_, encrypted_w_, scratch_);
+        }
+        encrypted_u_.resize(m_);
+        for (int i = 0; i < m_; i++)
+            swap(encrypted_u_[i], encrypted_w_[i]);
+        for (int i = 0; i < p_; i++)
+            swap(encrypted_z_[i], encrypted_w_[m_ + i]);
+        step_bounds(state_budget_, state_coeff_, state_degree_, state_budget_, state_coeff_, state_degree_);
+        refresh_requested_ = !step_fits(state_budget_, state_coeff_, state_degree_);
+        k_ = k_ + 1;
+        return encrypted_u_;
+    }
+
+    /*
+    Refresh protocol: when refresh_requested is set after update_control, pass get_state to the plant, which returns a 
+    fresh encryption of the same values, and install it with set_state before the next update_control.
+    */
+    bool refresh_requested() const
+    {
+        return refresh_requested_;
+    }
+
+    const vector<Ciphertext> &get_state()
+    {
+        encrypted_x_c_.assign(encrypted_z_.begin(), encrypted_z_.begin() + p_);
+        return encrypted_x_c_;
+    }
+
+    void set_state(const vector<Ciphertext> &encrypted_x_c)
+    {
+        if (encrypted_x_c.size() != p_)
+            throw invalid_argument("x_c has the wrong dimension");
+        for (int i = 0; i < p_; i++)
+            encrypted_z_[i] = encrypted_x_c[i];
+        state_budget_ = noise_estimator_->fresh();
+        state_coeff_ = 1;
+        state_degree_ = 32;
+        refresh_requested_ = 0;
+    }
+
+    /*
+    Access the estimated noise budget of the controller state.
+    */
+    double get_estimated_budget() const
+    {
+        return state_budget_;
+    }
+
+    // Destructor.
+    ~DynamicController() {}
+
+};
+
+
+/*
+Class that simulates an observer-based controller for a plant that only measures y = C*x, with an encrypted Luenberger 
+observer (or a steady-state Kalman filter, with its gain as L) that keeps the state estimate on the controller side:
+    x_hat[k+1] = (A - L*C)*x_hat[k] + B*u[k] + L*y[k],
+    u[k] = K*x_hat[k],
+so that the plant encrypts its p measurements (Dynamics::set_output) instead of its n states. Since u[k] is computed from 
+the same estimate, the update is evaluated as x_hat[k+1] = (A - L*C + B*K)*x_hat[k] + L*y[k], i.e., by a DynamicController 
+with F = A - L*C + B*K, G = L, H = K and J = 0: this takes one product per step instead of two, which the noise and the 
+growth of the encoding of x_hat would pay for, and x_hat is refreshed by the plant like any controller state.
+*/
+class ObserverController : public DynamicController
+{
+private:
+    /*
+    Check the dimensions and compute A - L*C + B*K.
+    */
+    static Matrix<int> observer_dynamics(Matrix<int> A, Matrix<int> B, Matrix<int> C, Matrix<int> L, Matrix<int> K)
+    {
+        const unsigned n = A.get_rows();
+        if (A.get_cols() != n || B.get_rows() != n || C.get_cols() != n || L.get_rows() != n || L.get_cols() != C.get_rows() 
+            || K.get_rows() != B.get_cols() || K.get_cols() != n)
+            throw invalid_argument("A, B, C, L and K have incompatible dimensions");
+        return A - L * C + B * K;
+    }
+
+public:
+    // Constructor: initializes the observer at time 0 with the plaintext matrices of the plant, the observer gain L, the 
+    // control gain K and the initial estimate x_hat0 (zero if empty).
+    ObserverController(Matrix<int> _A, Matrix<int> _B, Matrix<int> _C, Matrix<int> _L, Matrix<int> _K, 
+        vector<int> _x_hat0 = vector<int>())
+        : DynamicController(observer_dynamics(_A, _B, _C, _L, _K), _L, _K, Matrix<int>(_K.get_rows(), _C.get_rows(), 0), 
+            _x_hat0)
+    {
+    }
+
+};
+
+
+/*
+Class that simulates a linear controller with a real-valued plaintext gain, u[k] = K*x[k], in the CKKS scheme. The state 
+is packed in the slots of one ciphertext by RealDynamics and K*x is computed with the diagonal method, with vector rotations, 
+followed by one rescale. The control input is returned one level down.
+*/
+class RealController
+{
+private:
+    Matrix<double> K_; // Control gain matrix.
+
+    std::unique_ptr<seal::CKKSEncoder> ckks_encoder_; // CKKS encoder object.
+    std::unique_ptr<seal::Evaluator> evaluator_; // Evaluator object.
+    GaloisKeys galois_keys_; // Galois keys for the rotations of the diagonal method.
+
+    vector<Plaintext> diag_K_; // Plaintext diagonals of the control gain.
+    vector<Ciphertext> encrypted_u_; // Ciphertext control input.
+    Ciphertext scratch_; // Scratch ciphertext for the sums of the giant steps.
+    vector<Ciphertext> rotations_; // Baby-step rotations of the state.
+
+public:
+    int k_;  // time step
+
+    // Constructor: initializes the controller at time 0 with plaintext control gain.
+    RealController(Matrix<double> _K)
+    {
+        k_ = 0;
+        K_ = _K;
+        LOG_DEBUG("K: " << K_);
+        encrypted_u_.resize(1);
+    }
+
+    /*
+    Initialize the encryption parameters and the Galois keys for the rotations. The diagonals of K are encoded at the scale 
+    of the last prime, which the rescale removes, such that the control input has the scale of the state.
+    */
+    void getEncryption(const EncryptionParameters _parms, const std::shared_ptr<seal::SEALContext> _context, const PublicKey _public_key, 
+        const GaloisKeys _galois_keys)
+    {
+        if (_parms.coeff_modulus().size() < 2)
+            throw invalid_argument("the CKKS mode needs at least two primes in the coefficient modulus");
+        ckks_encoder_ = make_unique<CKKSEncoder>(_context);
+        evaluator_ = make_unique<Evaluator>(_context);
+        galois_keys_ = _galois_keys;
+        diag_K_ = encode_matrix_diagonals(ckks_encoder_, K_, static_cast<double>(_parms.coeff_modulus().back().value()));
+    }
+
+    /*
+    Compute the control action according to the control law. The result is written to a buffer owned by the controller, 
+    which is reused across time steps.
+    */
+    const vector<Ciphertext> &update_control(const vector<Ciphertext> &encrypted_x)
+    {
+        {
+            INSTRUMENT_PHASE(Phase::evaluate);
+            mult_matrix_vector_diagonal_ckks(evaluator_, galois_keys_, diag_K_, encrypted_x[0], encrypted_u_[0], scratch_, rotations_);
+        }
         k_ = k_ + 1;
         return encrypted_u_;
     }
 
     // Destructor.
-    ~Controller() {}
+    ~RealController() {}
 
 };
 
@@ -0,0 +1,458 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+
+#include "seal/seal.h"
+#include "Matrix.h"
+#include "helper.h"
+#include "ParameterPlanner.h"
+
+using namespace std;
+using namespace seal;
+
+/*
+Benchmark of the encrypted control loop. For every configuration in the sweep over the number of states n, the number of
+inputs m, the horizon T, the poly_modulus_degree (or "auto" for the parameters of the planner) and the mode (plaintext K, encrypted K, packed, or a fleet of plants
+multiplexed over the slots), run T steps of encode -> encrypt -> evaluate -> decrypt -> decode and report the latency
+percentiles of every phase, the throughput, the ciphertext bytes per step and the peak resident set size, as CSV (default)
+or JSON. In the fleet mode, a step serves as many plants as there are slots. In the plain and encrypted modes, the heap 
+allocations per step are also counted for the value-returning helpers and for the overloads that reuse caller-owned 
+buffers.
+
+Usage: ./encrypted_controller_bench [--n 2,8,32] [--m 2,8] [--T 20] [--degree 2048,4096,auto] [--mode plain,encrypted,packed,fleet]
+    [--threads 1] [--format csv|json]
+*/
+
+/*
+Count of the heap allocations of the process, through a replacement of the global operator new. While it is counted, 
+SEAL takes a new memory pool for every allocation (MMProfNew), so that the recycling of freed blocks by the pool does not 
+hide the allocations that a step makes.
+*/
+static std::atomic<std::uint64_t> heap_allocations(0);
+
+void *operator new(std::size_t size)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+const int num_phases = 5;
+const char *phase_names[num_phases] = {"encode", "encrypt", "evaluate", "decrypt", "decode"};
+
+/*
+Configuration of a run and its measurements.
+*/
+struct BenchResult
+{
+    int n, m, T, degree, threads;
+    string mode;
+    int plants; // Plants served per step.
+    vector<double> phase_us[num_phases]; // Latency of every phase in every step, in microseconds.
+    double steps_per_sec;
+    size_t bytes_x, bytes_u; // Ciphertext bytes of the state and of the control input per step.
+    long peak_rss_kb;
+    double allocs_by_value, allocs_reused; // Heap allocations per step with the value-returning helpers and with the reused buffers, -1 if not measured.
+    bool correct;
+};
+
+/*
+Parse a comma-separated list of ints or strings.
+*/
+vector<int> parse_ints(const string &arg)
+{
+    vector<int> values;
+    stringstream stream(arg);
+    string item;
+    while (getline(stream, item, ','))
+        values.push_back(stoi(item));
+    return values;
+}
+
+vector<string> parse_strings(const string &arg)
+{
+    vector<string> values;
+    stringstream stream(arg);
+    string item;
+    while (getline(stream, item, ','))
+        values.push_back(item);
+    return values;
+}
+
+/*
+Percentile of a vector of samples, by the nearest-rank method.
+*/
+double percentile(vector<double> samples, double p)
+{
+    if (samples.empty())
+        return 0;
+    sort(samples.begin(), samples.end());
+    size_t rank = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[rank];
+}
+
+/*
+Peak resident set size of the process, in kilobytes (ru_maxrss is in bytes on macOS).
+*/
+long peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/*
+Size of the data of a vector of ciphertexts, in bytes.
+*/
+size_t ciphertext_bytes(const vector<Ciphertext> &encrypted)
+{
+    size_t bytes = 0;
+    for (int i = 0; i < encrypted.size(); i++)
+        bytes += encrypted[i].uint64_count() * sizeof(std::uint64_t);
+    return bytes;
+}
+
+/*
+Random int matrix with entries in [-bound, bound].
+*/
+Matrix<int> random_matrix(unsigned rows, unsigned cols, int bound, mt19937 &engine)
+{
+    uniform_int_distribution<int> dist(-bound, bound);
+    Matrix<int> matrix(rows, cols, 0);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            matrix(i,j) = dist(engine);
+    return matrix;
+}
+
+/*
+Run T steps of the loop for one configuration. The state is redrawn at every step, so that the values stay in the range of
+the plaintext modulus independently of the closed-loop behavior. A degree of 0 takes the parameters of the planner for the
+bounds of K and of the state.
+*/
+BenchResult run_config(int n, int m, int T, int degree, const string &mode, int threads)
+{
+    BenchResult result = {n, m, T, degree, threads, mode, 1};
+    const bool packed = (mode == "packed");
+    const bool enc_gain = (mode == "encrypted");
+    const bool fleet = (mode == "fleet");
+    const int bound_K = 2, bound_x = 4;
+
+    EncryptionParameters parms(scheme_type::BFV);
+    if (degree == 0)
+    {
+        PlanRequirements requirements = {static_cast<unsigned>(n), static_cast<unsigned>(m), 0, 0, bound_K, bound_x, 0,
+            packed ? GainMode::packed : enc_gain ? GainMode::encrypted : fleet ? GainMode::multiplexed : GainMode::plain};
+        ParameterPlan plan = plan_parameters(requirements);
+        setup_params(parms, plan);
+        degree = result.degree = plan.poly_modulus_degree;
+    }
+    else
+    {
+        parms.set_poly_modulus_degree(degree);
+        parms.set_coeff_modulus(coeff_modulus_128(degree));
+        parms.set_plain_modulus((packed || fleet) ? 65537 : (1 << 8));
+    }
+    std::shared_ptr<seal::SEALContext> context = SEALContext::Create(parms);
+    KeyGenerator keygen(context);
+    std::unique_ptr<seal::IntegerEncoder> encoder = make_unique<IntegerEncoder>(parms.plain_modulus());
+    std::unique_ptr<seal::Encryptor> encryptor = make_unique<Encryptor>(context, keygen.public_key());
+    std::unique_ptr<seal::Decryptor> decryptor = make_unique<Decryptor>(context, keygen.secret_key());
+    std::unique_ptr<seal::Evaluator> evaluator = make_unique<Evaluator>(context);
+    std::unique_ptr<seal::BatchEncoder> batch_encoder;
+    GaloisKeys galois_keys;
+    RelinKeys relin_keys;
+    std::unique_ptr<ThreadPool> thread_pool;
+    if (threads > 1)
+        thread_pool = make_unique<ThreadPool>(threads);
+
+    mt19937 engine(1);
+    uniform_int_distribution<int> state_dist(-bound_x, bound_x);
+    Matrix<int> K = random_matrix(m, n, bound_K, engine);
+
+    /*
+    Offline: encode (and encrypt) the gain once.
+    */
+    Matrix<Plaintext> plain_K;
+    Matrix<Ciphertext> enc_K;
+    vector<Plaintext> diag_K;
+    vector<Plaintext> enco_zero(packed ? 1 : m);
+    if (fleet)
+    {
+        batch_encoder = make_unique<BatchEncoder>(context);
+        result.plants = batch_encoder->slot_count();
+        plain_K = encode_matrix_multiplexed(batch_encoder, K);
+        encode_vector_multiplexed(batch_encoder, vector<vector<int>>(1, vector<int>(m, 0)), enco_zero);
+    }
+    else if (packed)
+    {
+        batch_encoder = make_unique<BatchEncoder>(context);
+        diag_K = encode_matrix_diagonals(batch_encoder, K);
+        galois_keys = keygen.galois_keys(decomposition_bit_count, galois_elts_from_steps(diagonal_rotation_steps(m, n), degree));
+        batch_encoder->encode(vector<std::int64_t>(batch_encoder->slot_count(), 0), enco_zero[0]);
+    }
+    else
+    {
+        plain_K = encode_matrix(encoder, K);
+        if (enc_gain)
+        {
+            Ciphertext enc_zero;
+            encryptor->encrypt(encoder->encode(0), enc_zero);
+            enc_K = encrypt_matrix(encryptor, plain_K, enc_zero);
+            relin_keys = keygen.relin_keys(decomposition_bit_count);
+        }
+        encode_vector(encoder, vector<int>(m, 0), enco_zero);
+    }
+
+    vector<int> x(n), u;
+    vector<vector<int>> xs(result.plants, vector<int>(n)), us; // states and inputs of the fleet
+    vector<Plaintext> plain_x, plain_u;
+    vector<Ciphertext> encrypted_x, encrypted_u;
+    Ciphertext scratch;
+    vector<Ciphertext> rotations;
+    result.correct = true;
+    chrono::steady_clock::time_point start_loop = chrono::steady_clock::now();
+    for (int k = 0; k < T; k++)
+    {
+        for (int i = 0; i < n; i++)
+            x[i] = state_dist(engine);
+        for (int j = 0; fleet && j < result.plants; j++)
+            for (int i = 0; i < n; i++)
+                xs[j][i] = state_dist(engine);
+        chrono::steady_clock::time_point t[num_phases + 1];
+
+        t[0] = chrono::steady_clock::now();
+        if (fleet)
+            encode_vector_multiplexed(batch_encoder, xs, plain_x);
+        else if (packed)
+        {
+            plain_x.resize(1);
+            plain_x[0] = encode_vector_packed(batch_encoder, x, max(n, m));
+        }
+        else
+            encode_vector(encoder, x, plain_x);
+
+        t[1] = chrono::steady_clock::now();
+        encrypt_vector(encryptor, plain_x, encrypted_x);
+        if (!enc_gain)
+            encrypt_vector(encryptor, enco_zero, encrypted_u);
+
+        t[2] = chrono::steady_clock::now();
+        if (packed)
+            mult_matrix_vector_diagonal(evaluator, galois_keys, diag_K, encrypted_x[0], encrypted_u[0], scratch, rotations);
+        else if (enc_gain && thread_pool)
+        {
+            mult_matrix_vector(evaluator, enc_K, encrypted_x, encrypted_u, *thread_pool);
+            relinearize_vector(evaluator, relin_keys, encrypted_u, *thread_pool);
+            mod_switch_vector(evaluator, encrypted_u, context->last_parms_id());
+        }
+        else if (enc_gain)
+        {
+            mult_matrix_vector(evaluator, enc_K, encrypted_x, encrypted_u, scratch);
+            relinearize_vector(evaluator, relin_keys, encrypted_u);
+            mod_switch_vector(evaluator, encrypted_u, context->last_parms_id());
+        }
+        else if (thread_pool)
+            mult_matrix_vector(evaluator, plain_K, encrypted_x, encrypted_u, *thread_pool);
+        else
+            mult_matrix_vector(evaluator, plain_K, encrypted_x, encrypted_u, scratch);
+
+        t[3] = chrono::steady_clock::now();
+        decrypt_vector(decryptor, encrypted_u, plain_u);
+
+        t[4] = chrono::steady_clock::now();
+        if (fleet)
+            decode_vector_multiplexed(batch_encoder, plain_u, result.plants, us);
+        else if (packed)
+            u = decode_vector_packed(batch_encoder, plain_u[0], m);
+        else
+            decode_vector(encoder, plain_u, u);
+
+        t[5] = chrono::steady_clock::now();
+        for (int p = 0; p < num_phases; p++)
+            result.phase_us[p].push_back(chrono::duration<double, micro>(t[p + 1] - t[p]).count());
+        if (fleet)
+            for (int j = 0; j < result.plants; j++)
+                result.correct = result.correct && (us[j] == K * xs[j]);
+        else
+            result.correct = result.correct && (u == K * x);
+        result.bytes_x = ciphertext_bytes(encrypted_x);
+        result.bytes_u = ciphertext_bytes(encrypted_u);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_loop).count();
+    result.steps_per_sec = T / seconds;
+    result.peak_rss_kb = peak_rss_kb();
+
+    /*
+    Heap allocations per step, for the helpers that return by value (the state, the products and the control input are new
+    vectors of ciphertexts at every step) against the overloads that write into the buffers of the loop above, which are 
+    already allocated. Both run the same operations on the last state.
+    */
+    result.allocs_by_value = result.allocs_reused = -1;
+    if (!packed && !fleet && !thread_pool)
+    {
+        MMProfGuard guard(make_unique<MMProfNew>());
+        std::uint64_t count = heap_allocations.load();
+        for (int k = 0; k < T; k++)
+        {
+            vector<Ciphertext> encrypted_x_value = encrypt_vector(encryptor, encode_vector(encoder, x));
+            vector<Ciphertext> encrypted_u_value = enc_gain ? mult_matrix_vector(evaluator, enc_K, encrypted_x_value)
+                : mult_matrix_vector(evaluator, plain_K, encrypted_x_value, encrypt_vector(encryptor, enco_zero));
+            if (enc_gain)
+            {
+                relinearize_vector(evaluator, relin_keys, encrypted_u_value);
+                mod_switch_vector(evaluator, encrypted_u_value, context->last_parms_id());
+            }
+            u = decode_vector(encoder, decrypt_vector(decryptor, encrypted_u_value));
+        }
+        result.allocs_by_value = static_cast<double>(heap_allocations.load() - count) / T;
+        count = heap_allocations.load();
+        for (int k = 0; k < T; k++)
+        {
+            encode_vector(encoder, x, plain_x);
+            encrypt_vector(encryptor, plain_x, encrypted_x);
+            if (enc_gain)
+            {
+                mult_matrix_vector(evaluator, enc_K, encrypted_x, encrypted_u, scratch);
+                relinearize_vector(evaluator, relin_keys, encrypted_u);
+                mod_switch_vector(evaluator, encrypted_u, context->last_parms_id());
+            }
+            else
+            {
+                encrypt_vector(encryptor, enco_zero, encrypted_u);
+                mult_matrix_vector(evaluator, plain_K, encrypted_x, encrypted_u, scratch);
+            }
+            decrypt_vector(decryptor, encrypted_u, plain_u);
+            decode_vector(encoder, plain_u, u);
+        }
+        result.allocs_reused = static_cast<double>(heap_allocations.load() - count) / T;
+    }
+    return result;
+}
+
+/*
+Print the results as CSV, one row per configuration.
+*/
+void print_csv(const vector<BenchResult> &results)
+{
+    cout << "n,m,T,degree,mode,threads,plants,steps_per_sec,bytes_x,bytes_u,peak_rss_kb,allocs_by_value,allocs_reused,correct";
+    for (int p = 0; p < num_phases; p++)
+        cout << "," << phase_names[p] << "_p50_us," << phase_names[p] << "_p90_us," << phase_names[p] << "_p99_us";
+    cout << endl;
+    for (int r = 0; r < results.size(); r++)
+    {
+        const BenchResult &res = results[r];
+        cout << res.n << "," << res.m << "," << res.T << "," << res.degree << "," << res.mode << "," << res.threads << ","
+            << res.plants << "," << res.steps_per_sec << "," << res.bytes_x << "," << res.bytes_u << "," << res.peak_rss_kb << ","
+            << res.allocs_by_value << "," << res.allocs_reused << "," << res.correct;
+        for (int p = 0; p < num_phases; p++)
+            cout << "," << percentile(res.phase_us[p], 50) << "," << percentile(res.phase_us[p], 90) << ","
+                << percentile(res.phase_us[p], 99);
+        cout << endl;
+    }
+}
+
+/*
+Print the results as a JSON array, one object per configuration.
+*/
+void print_json(const vector<BenchResult> &results)
+{
+    cout << "[" << endl;
+    for (int r = 0; r < results.size(); r++)
+    {
+        const BenchResult &res = results[r];
+        cout << "  {\"n\": " << res.n << ", \"m\": " << res.m << ", \"T\": " << res.T << ", \"degree\": " << res.degree
+            << ", \"mode\": \"" << res.mode << "\", \"threads\": " << res.threads << ", \"plants\": " << res.plants
+            << ", \"steps_per_sec\": " << res.steps_per_sec
+            << ", \"bytes_x\": " << res.bytes_x << ", \"bytes_u\": " << res.bytes_u << ", \"peak_rss_kb\": " << res.peak_rss_kb
+            << ", \"allocs_by_value\": " << res.allocs_by_value << ", \"allocs_reused\": " << res.allocs_reused
+            << ", \"correct\": " << (res.correct ? "true" : "false") << ", \"phases\": {";
+        for (int p = 0; p < num_phases; p++)
+            cout << (p ? ", " : "") << "\"" << phase_names[p] << "\": {\"p50_us\": " << percentile(res.phase_us[p], 50)
+                << ", \"p90_us\": " << percentile(res.phase_us[p], 90) << ", \"p99_us\": " << percentile(res.phase_us[p], 99)
+                << ", \"max_us\": " << percentile(res.phase_us[p], 100) << "}";
+        cout << "}}" << (r + 1 < results.size() ? "," : "") << endl;
+    }
+    cout << "]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    vector<int> ns = {2, 8, 32};
+    vector<int> ms = {2, 8};
+    vector<int> Ts = {20};
+    vector<int> degrees = {2048, 4096};
+    vector<string> modes = {"plain", "encrypted", "packed"};
+    int threads = 1;
+    string format = "csv";
+
+    for (int a = 1; a + 1 < argc; a += 2)
+    {
+        string flag = argv[a];
+        string value = argv[a + 1];
+        if (flag == "--n")
+            ns = parse_ints(value);
+        else if (flag == "--m")
+            ms = parse_ints(value);
+        else if (flag == "--T")
+            Ts = parse_ints(value);
+        else if (flag == "--degree")
+        {
+            degrees.clear();
+            for (const string &degree : parse_strings(value))
+                degrees.push_back(degree == "auto" ? 0 : stoi(degree));
+        }
+        else if (flag == "--mode")
+            modes = parse_strings(value);
+        else if (flag == "--threads")
+            threads = stoi(value);
+        else if (flag == "--format")
+            format = value;
+        else
+        {
+            cerr << "Unknown option " << flag << endl;
+            return 1;
+        }
+    }
+
+    vector<BenchResult> results;
+    for (int d : degrees)
+        for (const string &mode : modes)
+            for (int n : ns)
+                for (int m : ms)
+                    for (int T : Ts)
+                        results.push_back(run_config(n, m, T, d, mode, threads));
+
+    if (format == "json")
+        print_json(results);
+    else
+        print_csv(results);
+
+    return 0;
+}
@@ -13,6 +13,9 @@
 #include "Matrix.h"
 #include "encrypted_controller.cpp"
 #include "helper.h"
+#include "PipelinedExecutor.h"
+#include "ParameterPlanner.h"
+#include "KeyCache.h"
 
 using namespace std;
 using namespace seal;
@@ -20,7 +23,11 @@ using namespace seal;
 
 int main()
 {
-	cout << "Hello SEAL! Let's try a basic encrypted controller." << endl;
+	LOG_INFO("Hello SEAL! Let's try a basic encrypted controller.");
+	/*
+	Log the state and the control input of every step, which the default level (info) leaves out.
+	*/
+	Logger::get().set_level(LogLevel::trace);
 
     const int n = 2; // number of states
     const int m = 2; // number of control inputs
@@ -35,10 +42,14 @@ int main()
     Matrix<int> K(m, n, K_arr);
 
 	/*
-	Instance of the EncryptionParameters class for the BFV scheme.
+	Instance of the EncryptionParameters class for the BFV scheme, with the smallest parameters that hold the values of the
+	loop over the horizon with plaintext K.
 	*/
+    PlanRequirements requirements = {n, m, 1, 2, 1, 1, T, GainMode::plain};
+    ParameterPlan plan = plan_parameters(requirements);
+    LOG_INFO(plan);
 	EncryptionParameters parms(scheme_type::BFV);
-    setup_params(parms);
+    setup_params(parms, plan);
     std::shared_ptr<seal::SEALContext> context = SEALContext::Create(parms);
     std::unique_ptr<seal::IntegerEncoder> encoder = make_unique<IntegerEncoder>(parms.plain_modulus()); // Encoder object.
     std::unique_ptr<seal::KeyGenerator> keygen = make_unique<KeyGenerator>(context);
@@ -51,47 +62,375 @@ int main()
     */
     Dynamics dynamics = Dynamics(x0, A, B);
     dynamics.setEncryption(parms, context, public_key, secret_key);
+    dynamics.set_zero_pool(4 * n);
 
     /*
     Initialize the controller with plaintext K and get the encryption parameters and public key.
     */
     Controller controller = Controller(K);
+    controller.set_ntt_form(true);
     controller.getEncryption(parms, context, public_key);
+    controller.set_zero_pool(4 * m);
 
     /*
-    Run the control loop for T-1 time steps.
+    Run the control loop for T time steps. The buffers are allocated in the first step and reused afterwards; the bench 
+    reports the heap allocations per step against the value-returning helpers.
     */
     for (int i=0; i < T; i++)
     {
         dynamics.get_control(controller.update_control(dynamics.return_state()));
     }
     
-    cout << "Re-initialize." << endl;
+    LOG_INFO("Re-initialize.");
+    /*
+    Instance of the EncryptionParameters class for the controller with ciphertext K, whose products and relinearization
+    need a larger noise budget. The parameters, the keys and the encrypted K are loaded from the key cache if it holds them
+    for these requirements and this K, and are generated and cached otherwise.
+    */
+    requirements.mode = GainMode::encrypted;
+    const string cache_path = "encrypted_controller.cache";
+    string cache_tag = plan_tag(requirements) + " decomposition_bit_count " + to_string(decomposition_bit_count) + " K ";
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < n; j++)
+            cache_tag += to_string(K(i, j)) + " ";
+    EncryptionParameters parms_enc(scheme_type::BFV);
+    std::shared_ptr<seal::SEALContext> context_enc;
+    PublicKey public_key_enc;
+    SecretKey secret_key_enc;
+    RelinKeys relin_keys_enc;
+    Matrix<Ciphertext> enc_K;
+    chrono::steady_clock::time_point start_keys = chrono::steady_clock::now();
+    try
+    {
+        KeyCache cache(cache_path);
+        if (cache.get("tag") != cache_tag)
+            throw runtime_error("the cache is for different requirements or a different K");
+        parms_enc = deserialize_parameters(cache.get("parameters"));
+        context_enc = SEALContext::Create(parms_enc);
+        public_key_enc = deserialize_public_key(context_enc, cache.get("public_key"));
+        secret_key_enc = deserialize_secret_key(context_enc, cache.get("secret_key"));
+        relin_keys_enc = deserialize_relin_keys(context_enc, cache.get("relin_keys"));
+        vector<Ciphertext> enc_K_entries;
+        deserialize_ciphertexts(context_enc, cache.get("enc_K"), enc_K_entries);
+        if (enc_K_entries.size() != static_cast<size_t>(m * n))
+            throw runtime_error("the cached encrypted K has the wrong size");
+        enc_K = Matrix<Ciphertext>(m, n, enc_K_entries.data());
+        LOG_INFO("Loaded the parameters, keys and encrypted K from " << cache_path);
+    }
+    catch (const exception &e)
+    {
+        LOG_INFO("Generating the parameters, keys and encrypted K (" << e.what() << ")");
+        ParameterPlan plan_enc = plan_parameters(requirements);
+        LOG_INFO(plan_enc);
+        setup_params(parms_enc, plan_enc);
+        context_enc = SEALContext::Create(parms_enc);
+        std::unique_ptr<seal::IntegerEncoder> encoder_enc = make_unique<IntegerEncoder>(parms_enc.plain_modulus());
+        std::unique_ptr<seal::KeyGenerator> keygen_enc = make_unique<KeyGenerator>(context_enc);
+        public_key_enc = keygen_enc->public_key();
+        secret_key_enc = keygen_enc->secret_key();
+        relin_keys_enc = keygen_enc->relin_keys(decomposition_bit_count);
+        std::unique_ptr<seal::Encryptor> encryptor_enc = make_unique<Encryptor>(context_enc, public_key_enc);
+        Matrix<Plaintext> plain_K = encode_matrix(encoder_enc, K);
+        Ciphertext enc_zero;
+        encryptor_enc->encrypt(encoder_enc->encode(0),enc_zero);
+        enc_K = encrypt_matrix(encryptor_enc, plain_K, enc_zero);
+
+        KeyCache cache;
+        cache.put("tag", cache_tag);
+        cache.put("parameters", serialize_parameters(parms_enc));
+        cache.put("public_key", serialize_public_key(public_key_enc));
+        cache.put("secret_key", serialize_secret_key(secret_key_enc));
+        cache.put("relin_keys", serialize_relin_keys(relin_keys_enc));
+        string enc_K_message;
+        serialize_ciphertexts(vector<Ciphertext>(enc_K.data(), enc_K.data() + m * n), enc_K_message);
+        cache.put("enc_K", move(enc_K_message));
+        cache.save(cache_path);
+    }
+    LOG_INFO("Startup of the encrypted controller: " << chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - start_keys).count() << " ms");
+
     /*
     Initialize the dynamics and the encryption parameters for a different controller.
     */
     Dynamics dynamics2 = Dynamics(x0, A, B);
-    dynamics2.setEncryption(parms, context, public_key, secret_key);
+    dynamics2.setEncryption(parms_enc, context_enc, public_key_enc, secret_key_enc);
+
+    /*
+    Initialize the controller with ciphertext K and its nonzero pattern, which the controller learns so that it skips the 
+    products with the zero entries, and get the encryption parameters, public key and relinearization keys.
+    */
+    Controller controller2 = Controller(enc_K, nonzero_pattern(K));
+    controller2.getEncryption(parms_enc, context_enc, public_key_enc, relin_keys_enc);
+    controller2.set_num_threads(std::thread::hardware_concurrency());
 
     /*
-    Initialize the controller with ciphertext K and get the encryption parameters and public key.
+    Run the control loop for T-1 time steps, and compare the estimated noise budget of the control input with the one 
+    decrypted by the plant.
     */
-    Matrix<Plaintext> plain_K = encode_matrix(encoder, K);
-    Ciphertext enc_zero;
-    encryptor->encrypt(encoder->encode(0),enc_zero);
-    Matrix<Ciphertext> enc_K = encrypt_matrix(encryptor, plain_K, enc_zero);
+    dynamics2.set_noise_check(true);
+    LOG_INFO("Estimated noise budget in encrypted_u: " << controller2.get_estimated_budget() << " bits");
+    for (int i=0; i < T; i++)
+    {
+        dynamics2.get_control(controller2.update_control(dynamics2.return_state()));
+    }
 
-    Controller controller2 = Controller(enc_K);
-    controller2.getEncryption(parms, context, public_key);
+    LOG_INFO("Re-initialize with a horizon of several time steps per round trip.");
+    /*
+    Initialize a controller that computes the control inputs of H time steps from one encrypted state, with the stacked 
+    gain [K; K(A+BK)], and the smallest parameters that hold its entries for states up to 256 in absolute value.
+    */
+    const unsigned H = 2;
+    Controller controller7 = Controller(K);
+    controller7.set_horizon(H, A, B);
+    std::int64_t bound_gain = 0;
+    for (unsigned i = 0; i < controller7.get_gain().get_rows(); i++)
+        for (unsigned j = 0; j < n; j++)
+            bound_gain = max<std::int64_t>(bound_gain, abs(controller7.get_gain()(i, j)));
+    PlanRequirements requirements_horizon = {n, m, 1, 2, bound_gain, 256, 0, GainMode::plain};
+    ParameterPlan plan_horizon = plan_parameters(requirements_horizon);
+    LOG_INFO(plan_horizon);
+    EncryptionParameters parms_horizon(scheme_type::BFV);
+    setup_params(parms_horizon, plan_horizon);
+    std::shared_ptr<seal::SEALContext> context_horizon = SEALContext::Create(parms_horizon);
+    KeyGenerator keygen_horizon(context_horizon);
+    Dynamics dynamics7 = Dynamics(x0, A, B);
+    dynamics7.setEncryption(parms_horizon, context_horizon, keygen_horizon.public_key(), keygen_horizon.secret_key());
+    controller7.getEncryption(parms_horizon, context_horizon, keygen_horizon.public_key());
+
+    /*
+    Run T round trips, each of which applies H control inputs open-loop.
+    */
+    for (int i=0; i < T; i++)
+    {
+        dynamics7.get_control_sequence(controller7.update_control(dynamics7.return_state()));
+    }
+
+    LOG_INFO("Re-initialize with a dynamic controller.");
+    /*
+    Instance of the EncryptionParameters class with the default parameters, whose larger plaintext modulus leaves room for 
+    the growth of the state of a dynamic controller.
+    */
+    EncryptionParameters parms_default(scheme_type::BFV);
+    setup_params(parms_default);
+    std::shared_ptr<seal::SEALContext> context_default = SEALContext::Create(parms_default);
+    KeyGenerator keygen_default(context_default);
+    PublicKey public_key_default = keygen_default.public_key();
+    SecretKey secret_key_default = keygen_default.secret_key();
+
+    /*
+    Initialize the dynamics and a dynamic controller with an integrator state, x_c[k+1] = x_c[k] + y_1[k] - y_2[k] and 
+    u[k] = [x_c[k]; 0] + K*y[k], whose state stays encrypted across the time steps. The IntegerEncoder encoding of x_c 
+    grows at every step, so the plant re-encrypts x_c whenever the controller requests it.
+    */
+    Dynamics dynamics6 = Dynamics(x0, A, B);
+    dynamics6.setEncryption(parms_default, context_default, public_key_default, secret_key_default);
+    int F_arr[1] = {1};
+    int G_arr[n] = {1, -1};
+    int H_arr[m] = {1, 0};
+    DynamicController controller6 = DynamicController(Matrix<int>(1, 1, F_arr), Matrix<int>(1, n, G_arr), 
+        Matrix<int>(m, 1, H_arr), K);
+    controller6.getEncryption(parms_default, context_default, public_key_default);
+    controller6.set_num_threads(std::thread::hardware_concurrency());
+
+    /*
+    Run the control loop for 3*T time steps, with the refreshes of x_c.
+    */
+    for (int i=0; i < 3 * T; i++)
+    {
+        dynamics6.get_control(controller6.update_control(dynamics6.return_state()));
+        if (controller6.refresh_requested())
+        {
+            LOG_INFO("Refresh of x_c after step " << i);
+            controller6.set_state(dynamics6.refresh(controller6.get_state()));
+        }
+    }
+
+    LOG_INFO("Re-initialize with an encrypted observer.");
+    /*
+    Initialize a plant that only measures y = x_1, and a controller that keeps an encrypted estimate of the state, updated 
+    by the observer x_hat[k+1] = (A - L*C)*x_hat[k] + B*u[k] + L*y[k], and applies u[k] = K*x_hat[k]. The plant encrypts one 
+    measurement per step instead of n states, and refreshes x_hat whenever the controller requests it. With A = I, x_2 
+    never shows in y, so this plant is a double integrator, which is observable from x_1: L = [2; 1] makes A - L*C 
+    nilpotent (a deadbeat observer), and the estimation error is zero after n steps from any initial estimate, here 
+    x_hat0 = [0 1]. K_obs = [0 1; 0 0] makes A + B*K_obs = [1 3; 0 -1], whose square is the identity, so the state stays 
+    bounded.
+    */
+    int A_obs_arr[n*n] = {1, 1, 0, 1};
+    Matrix<int> A_obs(n, n, A_obs_arr);
+    int K_obs_arr[m*n] = {0, 1, 0, 0};
+    Matrix<int> K_obs(m, n, K_obs_arr);
+    int C_arr[n] = {1, 0};
+    Matrix<int> C(1, n, C_arr);
+    int L_arr[n] = {2, 1};
+    Dynamics dynamics8 = Dynamics(x0, A_obs, B);
+    dynamics8.setEncryption(parms_default, context_default, public_key_default, secret_key_default);
+    dynamics8.set_output(C);
+    ObserverController controller8 = ObserverController(A_obs, B, C, Matrix<int>(n, 1, L_arr), K_obs, {0, 1});
+    controller8.getEncryption(parms_default, context_default, public_key_default);
+
+    /*
+    Run the control loop for 3*T time steps, with the refreshes of x_hat, and log the estimation error of every step.
+    */
+    for (int i=0; i < 3 * T; i++)
+    {
+        dynamics8.get_control(controller8.update_control(dynamics8.return_state()));
+        dynamics8.estimation_error(controller8.get_state());
+        if (controller8.refresh_requested())
+        {
+            LOG_INFO("Refresh of x_hat after step " << i);
+            controller8.set_state(dynamics8.refresh(controller8.get_state()));
+        }
+    }
+
+    LOG_INFO("Re-initialize in the packed mode.");
+    /*
+    Instance of the EncryptionParameters class for the BFV scheme with batching, and Galois keys for the rotations needed 
+    by the diagonal method.
+    */
+    requirements.mode = GainMode::packed;
+    ParameterPlan plan_packed = plan_parameters(requirements);
+    LOG_INFO(plan_packed);
+    EncryptionParameters parms_packed(scheme_type::BFV);
+    setup_params(parms_packed, plan_packed);
+    std::shared_ptr<seal::SEALContext> context_packed = SEALContext::Create(parms_packed);
+    std::unique_ptr<seal::KeyGenerator> keygen_packed = make_unique<KeyGenerator>(context_packed);
+    PublicKey public_key_packed = keygen_packed->public_key();
+    SecretKey secret_key_packed = keygen_packed->secret_key();
+    GaloisKeys galois_keys_packed = keygen_packed->galois_keys(decomposition_bit_count, 
+        galois_elts_from_steps(diagonal_rotation_steps(m, n), parms_packed.poly_modulus_degree()));
+
+    /*
+    Initialize the dynamics and the controller with plaintext K, with the state packed in the slots of one ciphertext.
+    */
+    Dynamics dynamics3 = Dynamics(x0, A, B, true);
+    dynamics3.setEncryption(parms_packed, context_packed, public_key_packed, secret_key_packed);
+    Controller controller3 = Controller(K, true);
+    controller3.getEncryption(parms_packed, context_packed, public_key_packed, galois_keys_packed);
 
     /*
     Run the control loop for T-1 time steps.
     */
     for (int i=0; i < T; i++)
     {
-        dynamics2.get_control(controller2.update_control(dynamics2.return_state()));
+        dynamics3.get_control(controller3.update_control(dynamics3.return_state()));
+    }
+
+    LOG_INFO("Re-initialize a fleet of plants in the multiplexed mode.");
+    /*
+    Initialize a fleet of plants that share K, with the states multiplexed over the slots, and the controller with
+    plaintext K constant over the slots: one evaluation of K*x serves all plants.
+    */
+    const int plants_in_fleet = 64;
+    vector<vector<int>> x0_fleet(plants_in_fleet, x0);
+    for (int j=0; j < plants_in_fleet; j++)
+        x0_fleet[j][0] = j % 3 - 1;
+    FleetDynamics fleet = FleetDynamics(x0_fleet, A, B);
+    fleet.setEncryption(parms_packed, context_packed, public_key_packed, secret_key_packed);
+    Controller controller_fleet = Controller(K);
+    controller_fleet.set_multiplexed(true);
+    controller_fleet.set_ntt_form(true);
+    controller_fleet.getEncryption(parms_packed, context_packed, public_key_packed);
+
+    /*
+    Run the control loop for T-1 time steps.
+    */
+    for (int i=0; i < T; i++)
+    {
+        fleet.get_control(controller_fleet.update_control(fleet.return_state()));
+    }
+
+    LOG_INFO("Re-initialize in the real-valued (CKKS) mode.");
+    /*
+    Instance of the EncryptionParameters class for the CKKS scheme, and Galois keys for the vector rotations needed by the 
+    diagonal method.
+    */
+    EncryptionParameters parms_real(scheme_type::CKKS);
+    setup_params_ckks(parms_real);
+    std::shared_ptr<seal::SEALContext> context_real = SEALContext::Create(parms_real);
+    std::unique_ptr<seal::KeyGenerator> keygen_real = make_unique<KeyGenerator>(context_real);
+    PublicKey public_key_real = keygen_real->public_key();
+    SecretKey secret_key_real = keygen_real->secret_key();
+    GaloisKeys galois_keys_real = keygen_real->galois_keys(decomposition_bit_count, 
+        galois_elts_from_steps(diagonal_rotation_steps(m, n), parms_real.poly_modulus_degree()));
+
+    /*
+    Initialize the dynamics and the controller with real-valued A, B and K, with the state packed in the slots of one 
+    ciphertext.
+    */
+    double x0_real_arr[n] = {1.0, -0.5};
+    double A_real_arr[n*n] = {1.0, 0.1, 0.0, 1.0};
+    double B_real_arr[n*m] = {1.0, 0.0, 0.0, 1.0};
+    double K_real_arr[m*n] = {-0.5, 0.25, 0.25, -0.5};
+    RealDynamics dynamics5 = RealDynamics(vector<double>(x0_real_arr, x0_real_arr + n), Matrix<double>(n, n, A_real_arr), 
+        Matrix<double>(n, m, B_real_arr));
+    dynamics5.setEncryption(parms_real, context_real, public_key_real, secret_key_real);
+    RealController controller5 = RealController(Matrix<double>(m, n, K_real_arr));
+    controller5.getEncryption(parms_real, context_real, public_key_real, galois_keys_real);
+
+    /*
+    Run the control loop for T-1 time steps.
+    */
+    for (int i=0; i < T; i++)
+    {
+        dynamics5.get_control(controller5.update_control(dynamics5.return_state()));
     }
 
+    LOG_INFO("Re-initialize with compile-time dimensions.");
+    /*
+    Initialize the dynamics and the controller with plaintext K on fixed-size matrices, for which the plant update is
+    unrolled and mismatched dimensions do not compile.
+    */
+    FixedVector<int, n> x0_fixed = {1, 1};
+    FixedDynamics<n, m> dynamics4 = FixedDynamics<n, m>(x0_fixed, FixedMatrix<int, n, n>(A_arr), FixedMatrix<int, n, m>(B_arr));
+    dynamics4.setEncryption(parms, context, public_key, secret_key);
+    FixedController<m, n> controller4 = FixedController<m, n>(FixedMatrix<int, m, n>(K_arr));
+    controller4.getEncryption(parms, context, public_key);
+
+    /*
+    Run the control loop for T-1 time steps.
+    */
+    for (int i=0; i < T; i++)
+    {
+        dynamics4.get_control(controller4.update_control(dynamics4.return_state()));
+    }
+
+    LOG_INFO("Re-initialize several loops in a pipeline.");
+    /*
+    Initialize independent loops with plaintext K, which run through the pipelined executor: the encryption, the
+    evaluation and the decryption of different loops overlap on three stage threads.
+    */
+    const int loops = 4;
+    vector<std::unique_ptr<Dynamics>> plants;
+    vector<std::unique_ptr<Controller>> controllers;
+    vector<Dynamics *> plant_ptrs;
+    vector<Controller *> controller_ptrs;
+    for (int l=0; l < loops; l++)
+    {
+        plants.push_back(make_unique<Dynamics>(x0, A, B));
+        plants[l]->setEncryption(parms, context, public_key, secret_key);
+        plants[l]->set_zero_pool(4 * n);
+        controllers.push_back(make_unique<Controller>(K));
+        controllers[l]->set_ntt_form(true);
+        controllers[l]->getEncryption(parms, context, public_key);
+        controllers[l]->set_zero_pool(4 * m);
+        plant_ptrs.push_back(plants[l].get());
+        controller_ptrs.push_back(controllers[l].get());
+    }
+    PipelinedExecutor<Dynamics, Controller> pipeline(plant_ptrs, controller_ptrs);
+    PipelineStats stats = pipeline.run(T);
+    LOG_INFO(stats.steps << " steps in " << stats.seconds << " s (" << stats.steps / stats.seconds << " steps/s); busy time of "
+        << "the encrypt, evaluate and decrypt stages: " << stats.busy_seconds[0] << " s, " << stats.busy_seconds[1] << " s, "
+        << stats.busy_seconds[2] << " s");
+
+#ifdef ENABLE_INSTRUMENTATION
+    /*
+    Print the per-step timings and counters, and write them to a trace file.
+    */
+    Logger::get().flush();
+    Instrumentation::get().print_summary(cout);
+    Instrumentation::get().write_trace("instrumentation_trace.csv");
+#endif
+
 	return 0;
 }
 
@@ -0,0 +1,236 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <memory>
+#include <chrono>
+
+#include "seal/seal.h"
+#include "Matrix.h"
+#include "encrypted_controller.cpp"
+#include "helper.h"
+#include "Serialization.h"
+#include "SocketChannel.h"
+#include "SharedMemoryRing.h"
+#include "ParameterPlanner.h"
+
+using namespace std;
+using namespace seal;
+
+/*
+Control loop with the plant and the controller on the two ends of a socket, as when the controller runs on a separate,
+untrusted host. The plant owns the keys: it sends the encryption parameters, the public key and, depending on the mode,
+the relinearization keys and the encrypted K, or the Galois keys, and then at every time step the encrypted state. The
+controller sends back the encrypted control input. Here both ends run on localhost, in two threads, and the plant reports
+the serialized bytes per step in each direction. With the shm transport, the setup goes through a Unix-domain socket and
+the time steps through two shared-memory rings, and the plant reports the handoff time per step instead.
+
+Usage: ./encrypted_controller_remote [--transport unix|tcp|shm] [--mode plain|encrypted|packed] [--T 5]
+*/
+
+const int n = 2; // number of states
+const int m = 2; // number of control inputs
+int x0_arr[n] = {1,1};
+int A_arr[n*n] = {1, 0, 0, 1};
+int B_arr[n*m] = {2, -2, -2, 2};
+int K_arr[m*n] = {-1,1,1,0};
+
+/*
+Plant side: set up the keys, send the public material, and run the loop.
+*/
+void run_plant(const string &address, const string &mode, int T, SharedMemoryRing *ring_x, SharedMemoryRing *ring_u)
+{
+    SocketChannel channel(address);
+    const bool packed = (mode == "packed");
+    PlanRequirements requirements = {n, m, 1, 2, 1, 1, static_cast<unsigned>(T),
+        packed ? GainMode::packed : (mode == "encrypted") ? GainMode::encrypted : GainMode::plain};
+    EncryptionParameters parms(scheme_type::BFV);
+    setup_params(parms, plan_parameters(requirements));
+    std::shared_ptr<seal::SEALContext> context = SEALContext::Create(parms);
+    KeyGenerator keygen(context);
+    PublicKey public_key = keygen.public_key();
+    SecretKey secret_key = keygen.secret_key();
+
+    channel.set_max_message_bytes(max_wire_message_bytes(parms, decomposition_bit_count, 0, m)); // only the control input comes back
+    channel.send(serialize_parameters(parms));
+    channel.send(serialize_public_key(public_key));
+    if (mode == "encrypted")
+    {
+        std::unique_ptr<seal::IntegerEncoder> encoder = make_unique<IntegerEncoder>(parms.plain_modulus());
+        std::unique_ptr<seal::Encryptor> encryptor = make_unique<Encryptor>(context, public_key);
+        Ciphertext enc_zero;
+        encryptor->encrypt(encoder->encode(0), enc_zero);
+        Matrix<Ciphertext> enc_K = encrypt_matrix(encryptor, encode_matrix(encoder, Matrix<int>(m, n, K_arr)), enc_zero);
+        channel.send(serialize_relin_keys(keygen.relin_keys(decomposition_bit_count)));
+        string message;
+        serialize_ciphertexts(vector<Ciphertext>(enc_K.data(), enc_K.data() + m * n), message);
+        channel.send(message);
+    }
+    else if (packed)
+        channel.send(serialize_galois_keys(keygen.galois_keys(decomposition_bit_count,
+            galois_elts_from_steps(diagonal_rotation_steps(m, n), parms.poly_modulus_degree()))));
+    cout << "Setup bytes sent: " << channel.get_bytes_sent() << endl;
+
+    Dynamics dynamics = Dynamics(vector<int>(x0_arr, x0_arr + n), Matrix<int>(n, n, A_arr), Matrix<int>(n, m, B_arr), packed);
+    dynamics.setEncryption(parms, context, public_key, secret_key);
+    string message_x, message_u;
+    vector<Ciphertext> encrypted_u;
+    for (int i=0; i < T; i++)
+    {
+        if (ring_x)
+        {
+            const vector<Ciphertext> &encrypted_x = dynamics.return_state();
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            ring_x->push(encrypted_x);
+            double handoff_us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            dynamics.get_control(*ring_u);
+            cout << "Step " << i << ": " << SharedMemoryRing::message_bytes(encrypted_x) << " bytes of x handed off in "
+                << handoff_us << " us" << endl;
+            continue;
+        }
+        uint64_t sent = channel.get_bytes_sent();
+        uint64_t received = channel.get_bytes_received();
+        serialize_ciphertexts(dynamics.return_state(), message_x);
+        channel.send(message_x);
+        channel.receive(message_u);
+        deserialize_ciphertexts(context, message_u, encrypted_u);
+        dynamics.get_control(encrypted_u);
+        cout << "Bytes in step " << i << ": x " << channel.get_bytes_sent() - sent << ", u "
+            << channel.get_bytes_received() - received << endl;
+    }
+}
+
+/*
+Controller side: receive the public material, and answer every encrypted state with the encrypted control input.
+*/
+void run_controller(SocketListener &listener, const string &mode, int T, SharedMemoryRing *ring_x, SharedMemoryRing *ring_u)
+{
+    std::unique_ptr<SocketChannel> channel = listener.accept();
+    string message;
+    channel->receive(message);
+    EncryptionParameters parms = deserialize_parameters(message);
+    std::shared_ptr<seal::SEALContext> context = SEALContext::Create(parms);
+    channel->set_max_message_bytes(max_wire_message_bytes(parms, decomposition_bit_count, 
+        (mode == "packed") ? diagonal_rotation_steps(m, n).size() : 0, m * n));
+    channel->receive(message);
+    PublicKey public_key = deserialize_public_key(context, message);
+
+    std::unique_ptr<Controller> controller;
+    if (mode == "encrypted")
+    {
+        channel->receive(message);
+        RelinKeys relin_keys = deserialize_relin_keys(context, message);
+        channel->receive(message);
+        vector<Ciphertext> entries;
+        deserialize_ciphertexts(context, message, entries);
+        Matrix<Ciphertext> enc_K(m, n, entries.data());
+        controller = make_unique<Controller>(enc_K);
+        controller->getEncryption(parms, context, public_key, relin_keys);
+    }
+    else if (mode == "packed")
+    {
+        channel->receive(message);
+        GaloisKeys galois_keys = deserialize_galois_keys(context, message);
+        controller = make_unique<Controller>(Matrix<int>(m, n, K_arr), true);
+        controller->getEncryption(parms, context, public_key, galois_keys);
+    }
+    else
+    {
+        controller = make_unique<Controller>(Matrix<int>(m, n, K_arr));
+        controller->getEncryption(parms, context, public_key);
+    }
+
+    vector<Ciphertext> encrypted_x;
+    string message_u;
+    for (int i=0; i < T; i++)
+    {
+        if (ring_x)
+        {
+            controller->update_control(*ring_x, *ring_u);
+            continue;
+        }
+        channel->receive(message);
+        deserialize_ciphertexts(context, message, encrypted_x);
+        serialize_ciphertexts(controller->update_control(encrypted_x), message_u);
+        channel->send(message_u);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    string transport = "unix";
+    string mode = "plain";
+    int T = 5;
+    for (int a = 1; a + 1 < argc; a += 2)
+    {
+        string flag = argv[a];
+        string value = argv[a + 1];
+        if (flag == "--transport")
+            transport = value;
+        else if (flag == "--mode")
+            mode = value;
+        else if (flag == "--T")
+            T = stoi(value);
+        else
+        {
+            cerr << "Unknown option " << flag << endl;
+            return 1;
+        }
+    }
+    const string address = (transport == "tcp") ? "tcp:127.0.0.1:47000" : "unix:/tmp/encrypted_controller.sock";
+    std::unique_ptr<SharedMemoryRing> ring_x, ring_u; // plant to controller, controller to plant
+    if (transport == "shm")
+    {
+        ring_x = make_unique<SharedMemoryRing>(4, 1 << 20);
+        ring_u = make_unique<SharedMemoryRing>(4, 1 << 20);
+    }
+
+    try
+    {
+        SocketListener listener(address);
+        std::exception_ptr controller_error, plant_error;
+        thread controller_thread([&]
+        {
+            try
+            {
+                run_controller(listener, mode, T, ring_x.get(), ring_u.get());
+            }
+            catch(...)
+            {
+                controller_error = current_exception();
+                if (ring_x)
+                {
+                    ring_x->set_closed();
+                    ring_u->set_closed();
+                }
+            }
+        });
+        try
+        {
+            run_plant(address, mode, T, ring_x.get(), ring_u.get());
+        }
+        catch(...)
+        {
+            // On failure, the closed connection stops the controller, and with the shm transport so do the closed rings
+            plant_error = current_exception();
+            if (ring_x)
+            {
+                ring_x->set_closed();
+                ring_u->set_closed();
+            }
+        }
+        controller_thread.join();
+        if (plant_error)
+            rethrow_exception(plant_error);
+        if (controller_error)
+            rethrow_exception(controller_error);
+    }
+    catch(const exception &e)
+    {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+	return 0;
+}
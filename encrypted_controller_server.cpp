@@ -0,0 +1,106 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <memory>
+
+#include "seal/seal.h"
+#include "Matrix.h"
+#include "encrypted_controller.cpp"
+#include "helper.h"
+#include "ControllerServer.h"
+
+using namespace std;
+using namespace seal;
+
+/*
+Many independent loops served by one controller server. At every sampling instant, the plants encrypt their states, the
+server releases the update_control jobs of all loops on its work-stealing pool, and the plants decrypt their control
+inputs. The loops have sampling periods of 1, 2 or 3 times the base period, and the server reports the deadline misses
+of every loop.
+
+Usage: ./encrypted_controller_server [--loops 16] [--period_ms 50] [--steps 5] [--threads <hardware concurrency>]
+*/
+
+int main(int argc, char *argv[])
+{
+    int num_loops = 16;
+    int period_ms = 50;
+    int steps = 5;
+    unsigned threads = std::thread::hardware_concurrency();
+    for (int a = 1; a + 1 < argc; a += 2)
+    {
+        string flag = argv[a];
+        string value = argv[a + 1];
+        if (flag == "--loops")
+            num_loops = stoi(value);
+        else if (flag == "--period_ms")
+            period_ms = stoi(value);
+        else if (flag == "--steps")
+            steps = stoi(value);
+        else if (flag == "--threads")
+            threads = stoi(value);
+        else
+        {
+            cerr << "Unknown option " << flag << endl;
+            return 1;
+        }
+    }
+
+    const int n = 2; // number of states
+    const int m = 2; // number of control inputs
+    int x0_arr[n] = {1,1};
+    int A_arr[n*n] = {1, 0, 0, 1};
+    int B_arr[n*m] = {2, -2, -2, 2};
+    int K_arr[m*n] = {-1,1,1,0};
+
+    EncryptionParameters parms(scheme_type::BFV);
+    setup_params(parms);
+    std::shared_ptr<seal::SEALContext> context = SEALContext::Create(parms);
+    KeyGenerator keygen(context);
+    PublicKey public_key = keygen.public_key();
+    SecretKey secret_key = keygen.secret_key();
+
+    /*
+    Initialize the plants and host their controllers in the server, under one context.
+    */
+    ControllerServer<Controller> server(parms, context, public_key, threads);
+    vector<std::unique_ptr<Dynamics>> plants;
+    for (int l = 0; l < num_loops; l++)
+    {
+        plants.push_back(make_unique<Dynamics>(vector<int>(x0_arr, x0_arr + n), Matrix<int>(n, n, A_arr),
+            Matrix<int>(n, m, B_arr)));
+        plants[l]->setEncryption(parms, context, public_key, secret_key);
+        std::unique_ptr<Controller> controller = make_unique<Controller>(Matrix<int>(m, n, K_arr));
+        controller->set_ntt_form(true);
+        server.add_loop(std::move(controller), chrono::milliseconds(period_ms * (1 + l % 3)));
+    }
+
+    /*
+    Run the loops: at every base period, release the loops whose sampling instant it is.
+    */
+    vector<const vector<Ciphertext> *> encrypted_u(num_loops, nullptr);
+    chrono::steady_clock::time_point tick = chrono::steady_clock::now();
+    for (int k = 0; k < 3 * steps; k++)
+    {
+        vector<ControllerServer<Controller>::Request> requests;
+        for (int l = 0; l < num_loops; l++)
+        {
+            if (k % (1 + l % 3) == 0)
+                requests.push_back({static_cast<unsigned>(l), &plants[l]->return_state(),
+                    [&](unsigned loop, const vector<Ciphertext> &u){ encrypted_u[loop] = &u; }});
+        }
+        this_thread::sleep_until(tick);
+        server.submit(requests, tick);
+        server.wait_idle();
+        for (int r = 0; r < requests.size(); r++)
+            plants[requests[r].loop]->get_control(*encrypted_u[requests[r].loop]);
+        tick += chrono::milliseconds(period_ms);
+    }
+
+    server.print_report(cout);
+
+	return 0;
+}
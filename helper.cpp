@@ -6,29 +6,45 @@ using namespace seal;
 /*
 Print a vector object.
 */
-void print_vector(const std::vector<int> v)
+void print_vector(const std::vector<int> &v)
 {
     for(int i = 0; i < v.size(); i++)
         cout << v[i] << ' ';
-    cout << endl;   
+    cout << '\n';
+}
+
+void print_vector(const std::vector<double> &v)
+{
+    for(int i = 0; i < v.size(); i++)
+        cout << v[i] << ' ';
+    cout << '\n';
 }
 
 /*
 Integer Encoder for a vector of int messages.
 */
-std::vector<Plaintext> encode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<int> message)
+std::vector<Plaintext> encode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<int> &message)
 {
 	std::vector<Plaintext> plain(message.size());
-	for(int i = 0; i < message.size(); i++)
-		plain[i] = encoder->encode(message[i]);
+	encode_vector(encoder, message, plain);
 	return plain;
 }
 
+/*
+Integer Encoder for a vector of int messages into a caller-owned buffer, which is reused across calls.
+*/
+void encode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<int> &message, std::vector<Plaintext> &plain)
+{
+	plain.resize(message.size());
+	for(int i = 0; i < message.size(); i++)
+		encoder->encode(static_cast<std::int64_t>(message[i]), plain[i]);
+}
+
 
 /*
 Integer Encoder for a matrix of int messages.
 */
-Matrix<Plaintext> encode_matrix(const std::unique_ptr<seal::IntegerEncoder> &encoder, const Matrix<int> message)
+Matrix<Plaintext> encode_matrix(const std::unique_ptr<seal::IntegerEncoder> &encoder, const Matrix<int> &message)
 {
 	Plaintext p = encoder->encode(0);
 	Matrix<Plaintext> plain(message.get_rows(), message.get_cols(), p);
@@ -41,33 +57,52 @@ Matrix<Plaintext> encode_matrix(const std::unique_ptr<seal::IntegerEncoder> &enc
 /*
 Integer Decoder for a vector of plaintexts.
 */
-std::vector<int> decode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<Plaintext> plain)
+std::vector<int> decode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<Plaintext> &plain)
 {
 	std::vector<int> message(plain.size());
+	decode_vector(encoder, plain, message);
+	return message;
+}
+
+/*
+Integer Decoder for a vector of plaintexts into a caller-owned buffer.
+*/
+void decode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<Plaintext> &plain, std::vector<int> &message)
+{
+	message.resize(plain.size());
 	for(int i = 0; i < plain.size(); i++)
     {
 		message[i] = encoder->decode_int32(plain[i]);
     }
-
-	return message;
 }
 
 /*
 Encrypt a vector of plaintexts.
 */
-std::vector<Ciphertext> encrypt_vector(const std::unique_ptr<seal::Encryptor> &encryptor, const std::vector<Plaintext> plain)
+std::vector<Ciphertext> encrypt_vector(const std::unique_ptr<seal::Encryptor> &encryptor, const std::vector<Plaintext> &plain)
 {
 	std::vector<Ciphertext> encrypted(plain.size());
+	encrypt_vector(encryptor, plain, encrypted);
+	return encrypted;
+}
+
+/*
+Encrypt a vector of plaintexts into a caller-owned buffer. The ciphertexts keep their allocation from the previous call.
+*/
+void encrypt_vector(const std::unique_ptr<seal::Encryptor> &encryptor, const std::vector<Plaintext> &plain, 
+    std::vector<Ciphertext> &encrypted)
+{
+	encrypted.resize(plain.size());
+	INSTRUMENT_COUNT(Counter::encrypt, plain.size());
 	for(int i = 0; i < plain.size(); i++)
 		encryptor->encrypt(plain[i], encrypted[i]);
-	return encrypted;
 }
 
 /*
 Encrypt a matrix of plaintexts. Pass an encryption of zero in order to be able to initialize the matrix, alternatively, pass 
 an encoder.
 */
-Matrix<Ciphertext> encrypt_matrix(const std::unique_ptr<seal::Encryptor> &encryptor, const Matrix<Plaintext> plain, const Ciphertext enc_zero)
+Matrix<Ciphertext> encrypt_matrix(const std::unique_ptr<seal::Encryptor> &encryptor, const Matrix<Plaintext> &plain, const Ciphertext &enc_zero)
 {
     Matrix<Ciphertext> encrypted(plain.get_rows(), plain.get_cols(), enc_zero);
     for(int i = 0; i < plain.get_rows(); i++)
@@ -79,12 +114,83 @@ Matrix<Ciphertext> encrypt_matrix(const std::unique_ptr<seal::Encryptor> &encryp
 /*
 Decrypt a vector of ciphertexts.
 */
-std::vector<Plaintext> decrypt_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> encrypted)
+std::vector<Plaintext> decrypt_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> &encrypted)
 {
 	std::vector<Plaintext> plain(encrypted.size());
+	decrypt_vector(decryptor, encrypted, plain);
+	return plain;
+}
+
+/*
+Decrypt a vector of ciphertexts into a caller-owned buffer.
+*/
+void decrypt_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> &encrypted, 
+    std::vector<Plaintext> &plain)
+{
+	plain.resize(encrypted.size());
+	INSTRUMENT_COUNT(Counter::decrypt, encrypted.size());
 	for(int i = 0; i < encrypted.size(); i++)
 		decryptor->decrypt(encrypted[i], plain[i]);
-	return plain;
+}
+
+/*
+Product of 64-bit matrices that throws instead of overflowing: every entry is first bounded in long double by the sum of 
+the magnitudes of its terms, so that the 64-bit sums that follow cannot overflow.
+*/
+static Matrix<std::int64_t> checked_product(Matrix<std::int64_t> lhs, const Matrix<std::int64_t> &rhs)
+{
+    const long double limit = static_cast<long double>(numeric_limits<std::int64_t>::max()) / 2;
+    for(unsigned i = 0; i < lhs.get_rows(); i++)
+        for(unsigned j = 0; j < rhs.get_cols(); j++)
+        {
+            long double bound = 0;
+            for(unsigned k = 0; k < lhs.get_cols(); k++)
+                bound += fabsl(static_cast<long double>(lhs(i, k))) * fabsl(static_cast<long double>(rhs(k, j)));
+            if (bound > limit)
+                throw invalid_argument("the stacked gain exceeds the range of int");
+        }
+    return lhs * rhs;
+}
+
+/*
+Stacked gain of a horizon of time steps. The blocks are computed with 64-bit matrices, K(A+BK)^(h+1) from K(A+BK)^h, whose 
+products are bounded before they are computed, so that an overflow of int is detected.
+*/
+Matrix<int> stack_horizon_gain(const Matrix<int> &K, const Matrix<int> &A, const Matrix<int> &B, unsigned horizon)
+{
+    const unsigned m = K.get_rows();
+    const unsigned n = K.get_cols();
+    if (A.get_rows() != n || A.get_cols() != n || B.get_rows() != n || B.get_cols() != m)
+        throw invalid_argument("the dimensions of A, B and K do not match");
+    Matrix<std::int64_t> block(m, n, std::int64_t(0)), A_64(n, n, std::int64_t(0)), B_64(n, m, std::int64_t(0));
+    for(unsigned i = 0; i < n; i++)
+    {
+        for(unsigned j = 0; j < n; j++)
+            A_64(i, j) = A(i, j);
+        for(unsigned j = 0; j < m; j++)
+            B_64(i, j) = B(i, j);
+    }
+    for(unsigned i = 0; i < m; i++)
+        for(unsigned j = 0; j < n; j++)
+            block(i, j) = K(i, j);
+    Matrix<std::int64_t> closed_loop = A_64;
+    if (horizon > 1)
+        closed_loop += checked_product(B_64, block);
+
+    Matrix<int> stacked(horizon * m, n, 0);
+    for(unsigned h = 0; h < horizon; h++)
+    {
+        for(unsigned i = 0; i < m; i++)
+            for(unsigned j = 0; j < n; j++)
+            {
+                if (block(i, j) > numeric_limits<int>::max() || block(i, j) < numeric_limits<int>::min())
+                    throw invalid_argument("the stacked gain exceeds the range of int");
+                stacked(h * m + i, j) = block(i, j);
+            }
+        if (h + 1 < horizon)
+            block = checked_product(block, closed_loop);
+    }
+    return stacked;
 }
 
 /*
@@ -92,10 +198,22 @@ Multiply a plaintext matrix by a ciphertext vector. Pass a vector of encrypted z
 to pass encoder and encryptor. SEAL does not allow multiplication by zero plaintexts, so we have to perform a separate check 
 for that.
 */
-std::vector<Ciphertext> mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> plain_matrix, 
-	const std::vector<Ciphertext> encrypted, std::vector<Ciphertext> result)
+std::vector<Ciphertext> mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &plain_matrix, 
+	const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> result)
+{
+	Ciphertext scratch;
+	mult_matrix_vector(evaluator, plain_matrix, encrypted, result, scratch);
+	return result;
+}
+
+/*
+Multiply a plaintext matrix by a ciphertext vector in place: result holds the encrypted zeros on entry and the product on 
+exit. Each product is written to the scratch ciphertext with an out-of-place multiplication, so that neither the input nor 
+the result is copied. Reusing result and scratch across time steps avoids allocations in the control loop.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &plain_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, Ciphertext &scratch)
 {
-	std::vector<Ciphertext> temp = encrypted;
 	try 
 	{
 		if (result.size() != plain_matrix.get_rows()) 
@@ -106,57 +224,995 @@ std::vector<Ciphertext> mult_matrix_vector(const std::unique_ptr<seal::Evaluator
 			{
 				if (!plain_matrix(i,j).is_zero())
 				{
-					evaluator->multiply_plain_inplace(temp[j], plain_matrix(i,j));
-					evaluator->add_inplace(result[i], temp[j]);
-					temp = encrypted;
+					evaluator->multiply_plain(encrypted[j], plain_matrix(i,j), scratch);
+					INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+					evaluator->add_inplace(result[i], scratch);
+					INSTRUMENT_COUNT(Counter::add, 1);
 				}
 			}
 		}
 	}
 	catch(const char* msg) 
 	{
-		cout << msg << endl;
+		LOG_ERROR(msg);
 	}	
-	return result;
 }
 
 /*
 Multiply a ciphertext matrix by a ciphertext vector.
 */
-std::vector<Ciphertext> mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Ciphertext> enc_matrix, 
-    const std::vector<Ciphertext> encrypted)
+std::vector<Ciphertext> mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted)
 {
     std::vector<Ciphertext> result(enc_matrix.get_rows());
-    std::vector<Ciphertext> temp = encrypted;
+    Ciphertext scratch;
+    mult_matrix_vector(evaluator, enc_matrix, encrypted, result, scratch);
+    return result;
+}
+
+/*
+Multiply a ciphertext matrix by a ciphertext vector into a caller-owned result, using a scratch ciphertext for the products.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, Ciphertext &scratch)
+{
+    result.resize(enc_matrix.get_rows());
     for(int i = 0; i < enc_matrix.get_rows(); i++)
     {
         for(int j = 0; j < enc_matrix.get_cols(); j++)
         {
-            evaluator->multiply_inplace(temp[j], enc_matrix(i,j));
             if(j!=0)
             {
-                evaluator->add_inplace(result[i], temp[j]);
+                evaluator->multiply(encrypted[j], enc_matrix(i,j), scratch);
+                INSTRUMENT_COUNT(Counter::multiply, 1);
+                evaluator->add_inplace(result[i], scratch);
+                INSTRUMENT_COUNT(Counter::add, 1);
+            }
+            else
+            {
+                evaluator->multiply(encrypted[j], enc_matrix(i,j), result[i]);
+                INSTRUMENT_COUNT(Counter::multiply, 1);
+            }
+        }
+    }
+}
+
+/*
+Sum each row of a matrix of ciphertexts with a tree reduction on a thread pool: at every level, term (i,j) absorbs term 
+(i,j+stride). Entries with present(i,j) == 0 are empty and are skipped. The sum of row i ends up in terms(i,0) if that row 
+has any present entry, which is then reported in present(i,0).
+*/
+void reduce_rows_tree(const std::unique_ptr<seal::Evaluator> &evaluator, Matrix<Ciphertext> &terms, Matrix<int> &present, 
+    ThreadPool &thread_pool)
+{
+    const unsigned rows = terms.get_rows();
+    const unsigned cols = terms.get_cols();
+    for(unsigned stride = 1; stride < cols; stride *= 2)
+    {
+        const unsigned pairs = (cols + 2 * stride - 1) / (2 * stride);
+        thread_pool.parallel_for(0, rows * pairs, [&](unsigned index, unsigned worker)
+        {
+            const unsigned i = index / pairs;
+            const unsigned j = (index % pairs) * 2 * stride;
+            if (j + stride >= cols || !present(i, j + stride))
+                return;
+            if (present(i, j))
+            {
+                evaluator->add_inplace(terms(i, j), terms(i, j + stride));
+                INSTRUMENT_COUNT(Counter::add, 1);
+            }
+            else
+                terms(i, j) = move(terms(i, j + stride));
+            present(i, j) = 1;
+        });
+    }
+}
+
+/*
+Multiply a plaintext matrix by a ciphertext vector on a thread pool, in place as above. The rows are split across the 
+workers; if there are fewer rows than workers, the products are computed in parallel and each row is summed with a tree 
+reduction instead. Each worker allocates from its own memory pool.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &plain_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, ThreadPool &thread_pool)
+{
+    try 
+    {
+        if (result.size() != plain_matrix.get_rows()) 
+            throw "Dimensions incompatible!";
+        const unsigned rows = plain_matrix.get_rows();
+        const unsigned cols = plain_matrix.get_cols();
+        if (rows >= thread_pool.get_num_threads())
+        {
+            thread_pool.parallel_for(0, rows, [&](unsigned i, unsigned worker)
+            {
+                MemoryPoolHandle pool = thread_pool.get_memory_pool(worker);
+                Ciphertext scratch(pool);
+                for(int j = 0; j < cols; j++)
+                {
+                    if (!plain_matrix(i,j).is_zero())
+                    {
+                        evaluator->multiply_plain(encrypted[j], plain_matrix(i,j), scratch, pool);
+                        INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                        evaluator->add_inplace(result[i], scratch);
+                        INSTRUMENT_COUNT(Counter::add, 1);
+                    }
+                }
+            });
+        }
+        else
+        {
+            /*
+            Column 0 holds the initial value of the result, columns 1..cols hold the products.
+            */
+            Matrix<Ciphertext> terms(rows, cols + 1, Ciphertext());
+            Matrix<int> present(rows, cols + 1, 0);
+            thread_pool.parallel_for(0, rows * (cols + 1), [&](unsigned index, unsigned worker)
+            {
+                const unsigned i = index / (cols + 1);
+                const unsigned j = index % (cols + 1);
+                if (j == 0)
+                {
+                    terms(i, 0) = move(result[i]);
+                    present(i, 0) = 1;
+                }
+                else if (!plain_matrix(i,j-1).is_zero())
+                {
+                    MemoryPoolHandle pool = thread_pool.get_memory_pool(worker);
+                    terms(i, j) = Ciphertext(pool);
+                    evaluator->multiply_plain(encrypted[j-1], plain_matrix(i,j-1), terms(i, j), pool);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                    present(i, j) = 1;
+                }
+            });
+            reduce_rows_tree(evaluator, terms, present, thread_pool);
+            for(int i = 0; i < rows; i++)
+                result[i] = move(terms(i, 0));
+        }
+    }
+    catch(const char* msg) 
+    {
+        LOG_ERROR(msg);
+    }
+}
+
+/*
+Multiply a ciphertext matrix by a ciphertext vector on a thread pool into a caller-owned result, as above.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, ThreadPool &thread_pool)
+{
+    const unsigned rows = enc_matrix.get_rows();
+    const unsigned cols = enc_matrix.get_cols();
+    result.resize(rows);
+    if (rows >= thread_pool.get_num_threads())
+    {
+        thread_pool.parallel_for(0, rows, [&](unsigned i, unsigned worker)
+        {
+            MemoryPoolHandle pool = thread_pool.get_memory_pool(worker);
+            Ciphertext scratch(pool);
+            for(int j = 0; j < cols; j++)
+            {
+                if(j != 0)
+                {
+                    evaluator->multiply(encrypted[j], enc_matrix(i,j), scratch, pool);
+                    INSTRUMENT_COUNT(Counter::multiply, 1);
+                    evaluator->add_inplace(result[i], scratch);
+                    INSTRUMENT_COUNT(Counter::add, 1);
+                }
+                else
+                {
+                    evaluator->multiply(encrypted[j], enc_matrix(i,j), result[i], pool);
+                    INSTRUMENT_COUNT(Counter::multiply, 1);
+                }
+            }
+        });
+    }
+    else
+    {
+        Matrix<Ciphertext> terms(rows, cols, Ciphertext());
+        Matrix<int> present(rows, cols, 1);
+        thread_pool.parallel_for(0, rows * cols, [&](unsigned index, unsigned worker)
+        {
+            const unsigned i = index / cols;
+            const unsigned j = index % cols;
+            MemoryPoolHandle pool = thread_pool.get_memory_pool(worker);
+            terms(i, j) = Ciphertext(pool);
+            evaluator->multiply(encrypted[j], enc_matrix(i,j), terms(i, j), pool);
+            INSTRUMENT_COUNT(Counter::multiply, 1);
+        });
+        reduce_rows_tree(evaluator, terms, present, thread_pool);
+        for(int i = 0; i < rows; i++)
+            result[i] = move(terms(i, 0));
+    }
+}
+
+/*
+Relinearize each ciphertext of a vector in place back to size 2.
+*/
+void relinearize_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const RelinKeys &relin_keys, 
+    std::vector<Ciphertext> &encrypted)
+{
+    for(int i = 0; i < encrypted.size(); i++)
+    {
+        if(encrypted[i].size() > 2)
+        {
+            evaluator->relinearize_inplace(encrypted[i], relin_keys);
+            INSTRUMENT_COUNT(Counter::relinearize, 1);
+        }
+    }
+}
+
+/*
+Relinearize each ciphertext of a vector in place on a thread pool.
+*/
+void relinearize_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const RelinKeys &relin_keys, 
+    std::vector<Ciphertext> &encrypted, ThreadPool &thread_pool)
+{
+    thread_pool.parallel_for(0, encrypted.size(), [&](unsigned i, unsigned worker)
+    {
+        if(encrypted[i].size() > 2)
+        {
+            evaluator->relinearize_inplace(encrypted[i], relin_keys, thread_pool.get_memory_pool(worker));
+            INSTRUMENT_COUNT(Counter::relinearize, 1);
+        }
+    });
+}
+
+/*
+Switch each ciphertext of a vector in place down to the level of the given parms_id.
+*/
+void mod_switch_vector(const std::unique_ptr<seal::Evaluator> &evaluator, std::vector<Ciphertext> &encrypted, 
+    parms_id_type parms_id)
+{
+    for(int i = 0; i < encrypted.size(); i++)
+    {
+        if(encrypted[i].parms_id() != parms_id)
+            evaluator->mod_switch_to_inplace(encrypted[i], parms_id);
+    }
+}
+
+/*
+Transform a plaintext matrix to NTT form, such that its products with ciphertexts in NTT form need no transforms.
+*/
+void transform_to_ntt_matrix(const std::unique_ptr<seal::Evaluator> &evaluator, Matrix<Plaintext> &plain_matrix, 
+    parms_id_type parms_id)
+{
+    for(int i = 0; i < plain_matrix.get_rows(); i++)
+        for(int j = 0; j < plain_matrix.get_cols(); j++)
+            if (!plain_matrix(i,j).is_zero())
+                evaluator->transform_to_ntt_inplace(plain_matrix(i,j), parms_id);
+}
+
+/*
+Multiply a plaintext matrix in NTT form by a ciphertext vector, adding the product to result, which holds the encrypted zeros 
+on entry. The n inputs are transformed to NTT form once into the encrypted_ntt buffer, each row is accumulated in NTT form, 
+and each of the m sums is transformed back once, i.e., O(m+n) transforms instead of O(m*n).
+*/
+void mult_matrix_vector_ntt(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &ntt_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &encrypted_ntt, std::vector<Ciphertext> &result, 
+    Ciphertext &accumulator, Ciphertext &scratch)
+{
+    try 
+    {
+        if (result.size() != ntt_matrix.get_rows() || encrypted.size() != ntt_matrix.get_cols()) 
+            throw "Dimensions incompatible!";
+        encrypted_ntt.resize(encrypted.size());
+        for(int j = 0; j < encrypted.size(); j++)
+            evaluator->transform_to_ntt(encrypted[j], encrypted_ntt[j]);
+        for(int i = 0; i < ntt_matrix.get_rows(); i++)
+        {
+            bool empty = true;
+            for(int j = 0; j < ntt_matrix.get_cols(); j++)
+            {
+                if (ntt_matrix(i,j).is_zero())
+                    continue;
+                if (empty)
+                {
+                    evaluator->multiply_plain(encrypted_ntt[j], ntt_matrix(i,j), accumulator);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                    empty = false;
+                }
+                else
+                {
+                    evaluator->multiply_plain(encrypted_ntt[j], ntt_matrix(i,j), scratch);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                    evaluator->add_inplace(accumulator, scratch);
+                    INSTRUMENT_COUNT(Counter::add, 1);
+                }
+            }
+            if (!empty)
+            {
+                evaluator->transform_from_ntt_inplace(accumulator);
+                evaluator->add_inplace(result[i], accumulator);
+                INSTRUMENT_COUNT(Counter::add, 1);
+            }
+        }
+    }
+    catch(const char* msg) 
+    {
+        LOG_ERROR(msg);
+    }
+}
+
+/*
+Multiply a plaintext matrix in NTT form by a ciphertext vector on a thread pool, as above: the forward transforms and the 
+rows are split across the workers.
+*/
+void mult_matrix_vector_ntt(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &ntt_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &encrypted_ntt, std::vector<Ciphertext> &result, 
+    ThreadPool &thread_pool)
+{
+    try 
+    {
+        if (result.size() != ntt_matrix.get_rows() || encrypted.size() != ntt_matrix.get_cols()) 
+            throw "Dimensions incompatible!";
+        encrypted_ntt.resize(encrypted.size());
+        thread_pool.parallel_for(0, encrypted.size(), [&](unsigned j, unsigned worker)
+        {
+            evaluator->transform_to_ntt(encrypted[j], encrypted_ntt[j]);
+        });
+        thread_pool.parallel_for(0, ntt_matrix.get_rows(), [&](unsigned i, unsigned worker)
+        {
+            MemoryPoolHandle pool = thread_pool.get_memory_pool(worker);
+            Ciphertext accumulator(pool);
+            Ciphertext scratch(pool);
+            bool empty = true;
+            for(int j = 0; j < ntt_matrix.get_cols(); j++)
+            {
+                if (ntt_matrix(i,j).is_zero())
+                    continue;
+                if (empty)
+                {
+                    evaluator->multiply_plain(encrypted_ntt[j], ntt_matrix(i,j), accumulator, pool);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                    empty = false;
+                }
+                else
+                {
+                    evaluator->multiply_plain(encrypted_ntt[j], ntt_matrix(i,j), scratch, pool);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                    evaluator->add_inplace(accumulator, scratch);
+                    INSTRUMENT_COUNT(Counter::add, 1);
+                }
+            }
+            if (!empty)
+            {
+                evaluator->transform_from_ntt_inplace(accumulator);
+                evaluator->add_inplace(result[i], accumulator);
+                INSTRUMENT_COUNT(Counter::add, 1);
+            }
+        });
+    }
+    catch(const char* msg) 
+    {
+        LOG_ERROR(msg);
+    }
+}
+
+/*
+Multiply a sparse plaintext matrix by a ciphertext vector in place.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Plaintext> &plain_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, Ciphertext &scratch)
+{
+    try 
+    {
+        if (result.size() != plain_matrix.get_rows() || encrypted.size() != plain_matrix.get_cols()) 
+            throw "Dimensions incompatible!";
+        for(unsigned i = 0; i < plain_matrix.get_rows(); i++)
+        {
+            for(unsigned k = plain_matrix.row_begin(i); k < plain_matrix.row_end(i); k++)
+            {
+                evaluator->multiply_plain(encrypted[plain_matrix.col(k)], plain_matrix.value(k), scratch);
+                INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                evaluator->add_inplace(result[i], scratch);
+                INSTRUMENT_COUNT(Counter::add, 1);
+            }
+        }
+    }
+    catch(const char* msg) 
+    {
+        LOG_ERROR(msg);
+    }
+}
+
+/*
+Multiply a sparse ciphertext matrix by a ciphertext vector into a caller-owned result: the first product of a row is written 
+to the result, the others are added to it.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, Ciphertext &scratch)
+{
+    result.resize(enc_matrix.get_rows());
+    for(unsigned i = 0; i < enc_matrix.get_rows(); i++)
+    {
+        for(unsigned k = enc_matrix.row_begin(i); k < enc_matrix.row_end(i); k++)
+        {
+            if (k != enc_matrix.row_begin(i))
+            {
+                evaluator->multiply(encrypted[enc_matrix.col(k)], enc_matrix.value(k), scratch);
+                INSTRUMENT_COUNT(Counter::multiply, 1);
+                evaluator->add_inplace(result[i], scratch);
+                INSTRUMENT_COUNT(Counter::add, 1);
+            }
+            else
+            {
+                evaluator->multiply(encrypted[enc_matrix.col(k)], enc_matrix.value(k), result[i]);
+                INSTRUMENT_COUNT(Counter::multiply, 1);
+            }
+        }
+    }
+}
+
+/*
+Sum the products of the nonzeros of every row of a sparse matrix on a thread pool. product(k, destination, pool) computes the 
+product of nonzero k; with accumulate, the sum of a row is added to its entry of the result, otherwise it replaces it. The 
+rows are split across the workers, or, with fewer rows than workers, all products are computed in parallel and then summed 
+within each row with a tree reduction: at every level, product k absorbs product k+stride of the same row.
+*/
+template <typename Product>
+static void sum_sparse_rows(const std::unique_ptr<seal::Evaluator> &evaluator, const std::vector<unsigned> &row_offsets, 
+    std::vector<Ciphertext> &result, bool accumulate, ThreadPool &thread_pool, Product product)
+{
+    const unsigned rows = row_offsets.size() - 1;
+    if (rows >= thread_pool.get_num_threads())
+    {
+        thread_pool.parallel_for(0, rows, [&](unsigned i, unsigned worker)
+        {
+            MemoryPoolHandle pool = thread_pool.get_memory_pool(worker);
+            Ciphertext scratch(pool);
+            for(unsigned k = row_offsets[i]; k < row_offsets[i + 1]; k++)
+            {
+                if (!accumulate && k == row_offsets[i])
+                {
+                    product(k, result[i], pool);
+                    continue;
+                }
+                product(k, scratch, pool);
+                evaluator->add_inplace(result[i], scratch);
+                INSTRUMENT_COUNT(Counter::add, 1);
+            }
+        });
+        return;
+    }
+
+    const unsigned nnz = row_offsets[rows];
+    std::vector<Ciphertext> terms(nnz);
+    thread_pool.parallel_for(0, nnz, [&](unsigned k, unsigned worker)
+    {
+        MemoryPoolHandle pool = thread_pool.get_memory_pool(worker);
+        terms[k] = Ciphertext(pool);
+        product(k, terms[k], pool);
+    });
+    unsigned longest = 0;
+    for(unsigned i = 0; i < rows; i++)
+        longest = max(longest, row_offsets[i + 1] - row_offsets[i]);
+    for(unsigned stride = 1; stride < longest; stride *= 2)
+    {
+        thread_pool.parallel_for(0, nnz, [&](unsigned k, unsigned worker)
+        {
+            const unsigned i = upper_bound(row_offsets.begin(), row_offsets.end(), k) - row_offsets.begin() - 1;
+            if ((k - row_offsets[i]) % (2 * stride) != 0 || k + stride >= row_offsets[i + 1])
+                return;
+            evaluator->add_inplace(terms[k], terms[k + stride]);
+            INSTRUMENT_COUNT(Counter::add, 1);
+        });
+    }
+    for(unsigned i = 0; i < rows; i++)
+    {
+        if (row_offsets[i] == row_offsets[i + 1])
+            continue;
+        if (accumulate)
+        {
+            evaluator->add_inplace(result[i], terms[row_offsets[i]]);
+            INSTRUMENT_COUNT(Counter::add, 1);
+        }
+        else
+            result[i] = move(terms[row_offsets[i]]);
+    }
+}
+
+/*
+Multiply a sparse plaintext matrix by a ciphertext vector on a thread pool, in place.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Plaintext> &plain_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, ThreadPool &thread_pool)
+{
+    try 
+    {
+        if (result.size() != plain_matrix.get_rows() || encrypted.size() != plain_matrix.get_cols()) 
+            throw "Dimensions incompatible!";
+        sum_sparse_rows(evaluator, plain_matrix.get_row_offsets(), result, true, thread_pool, 
+            [&](unsigned k, Ciphertext &destination, MemoryPoolHandle pool)
+            {
+                evaluator->multiply_plain(encrypted[plain_matrix.col(k)], plain_matrix.value(k), destination, pool);
+                INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+            });
+    }
+    catch(const char* msg) 
+    {
+        LOG_ERROR(msg);
+    }
+}
+
+/*
+Multiply a sparse ciphertext matrix by a ciphertext vector on a thread pool into a caller-owned result.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, ThreadPool &thread_pool)
+{
+    result.resize(enc_matrix.get_rows());
+    sum_sparse_rows(evaluator, enc_matrix.get_row_offsets(), result, false, thread_pool, 
+        [&](unsigned k, Ciphertext &destination, MemoryPoolHandle pool)
+        {
+            evaluator->multiply(encrypted[enc_matrix.col(k)], enc_matrix.value(k), destination, pool);
+            INSTRUMENT_COUNT(Counter::multiply, 1);
+        });
+}
+
+/*
+Transform the nonzeros of a sparse plaintext matrix to NTT form.
+*/
+void transform_to_ntt_matrix(const std::unique_ptr<seal::Evaluator> &evaluator, SparseMatrix<Plaintext> &plain_matrix, 
+    parms_id_type parms_id)
+{
+    for(unsigned k = 0; k < plain_matrix.nnz(); k++)
+        evaluator->transform_to_ntt_inplace(plain_matrix.value(k), parms_id);
+}
+
+/*
+Multiply a sparse plaintext matrix in NTT form by a ciphertext vector, adding the product to result.
+*/
+void mult_matrix_vector_ntt(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Plaintext> &ntt_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &encrypted_ntt, std::vector<Ciphertext> &result, 
+    Ciphertext &accumulator, Ciphertext &scratch)
+{
+    try 
+    {
+        if (result.size() != ntt_matrix.get_rows() || encrypted.size() != ntt_matrix.get_cols()) 
+            throw "Dimensions incompatible!";
+        encrypted_ntt.resize(encrypted.size());
+        for(unsigned j : ntt_matrix.get_used_cols())
+            evaluator->transform_to_ntt(encrypted[j], encrypted_ntt[j]);
+        for(unsigned i = 0; i < ntt_matrix.get_rows(); i++)
+        {
+            if (ntt_matrix.row_begin(i) == ntt_matrix.row_end(i))
+                continue;
+            for(unsigned k = ntt_matrix.row_begin(i); k < ntt_matrix.row_end(i); k++)
+            {
+                if (k == ntt_matrix.row_begin(i))
+                {
+                    evaluator->multiply_plain(encrypted_ntt[ntt_matrix.col(k)], ntt_matrix.value(k), accumulator);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                }
+                else
+                {
+                    evaluator->multiply_plain(encrypted_ntt[ntt_matrix.col(k)], ntt_matrix.value(k), scratch);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                    evaluator->add_inplace(accumulator, scratch);
+                    INSTRUMENT_COUNT(Counter::add, 1);
+                }
+            }
+            evaluator->transform_from_ntt_inplace(accumulator);
+            evaluator->add_inplace(result[i], accumulator);
+            INSTRUMENT_COUNT(Counter::add, 1);
+        }
+    }
+    catch(const char* msg) 
+    {
+        LOG_ERROR(msg);
+    }
+}
+
+/*
+Multiply a sparse plaintext matrix in NTT form by a ciphertext vector on a thread pool: the forward transforms of the used 
+columns and the rows are split across the workers.
+*/
+void mult_matrix_vector_ntt(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Plaintext> &ntt_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &encrypted_ntt, std::vector<Ciphertext> &result, 
+    ThreadPool &thread_pool)
+{
+    try 
+    {
+        if (result.size() != ntt_matrix.get_rows() || encrypted.size() != ntt_matrix.get_cols()) 
+            throw "Dimensions incompatible!";
+        encrypted_ntt.resize(encrypted.size());
+        const std::vector<unsigned> &used_cols = ntt_matrix.get_used_cols();
+        thread_pool.parallel_for(0, used_cols.size(), [&](unsigned index, unsigned worker)
+        {
+            evaluator->transform_to_ntt(encrypted[used_cols[index]], encrypted_ntt[used_cols[index]]);
+        });
+        thread_pool.parallel_for(0, ntt_matrix.get_rows(), [&](unsigned i, unsigned worker)
+        {
+            if (ntt_matrix.row_begin(i) == ntt_matrix.row_end(i))
+                return;
+            MemoryPoolHandle pool = thread_pool.get_memory_pool(worker);
+            Ciphertext accumulator(pool);
+            Ciphertext scratch(pool);
+            for(unsigned k = ntt_matrix.row_begin(i); k < ntt_matrix.row_end(i); k++)
+            {
+                if (k == ntt_matrix.row_begin(i))
+                {
+                    evaluator->multiply_plain(encrypted_ntt[ntt_matrix.col(k)], ntt_matrix.value(k), accumulator, pool);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                }
+                else
+                {
+                    evaluator->multiply_plain(encrypted_ntt[ntt_matrix.col(k)], ntt_matrix.value(k), scratch, pool);
+                    INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+                    evaluator->add_inplace(accumulator, scratch);
+                    INSTRUMENT_COUNT(Counter::add, 1);
+                }
+            }
+            evaluator->transform_from_ntt_inplace(accumulator);
+            evaluator->add_inplace(result[i], accumulator);
+            INSTRUMENT_COUNT(Counter::add, 1);
+        });
+    }
+    catch(const char* msg) 
+    {
+        LOG_ERROR(msg);
+    }
+}
+
+/*
+Batch Encoder for a vector of int messages. The message is zero-padded to the given period and written twice in a row of 
+slots, so that row rotations by up to period-1 steps still read the right entries (needed by the diagonal method).
+*/
+Plaintext encode_vector_packed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const std::vector<int> &message, 
+    unsigned period)
+{
+    if (message.size() > period || 2 * period > batch_encoder->slot_count() / 2)
+        throw invalid_argument("message does not fit in a row of slots");
+    std::vector<std::int64_t> slots(batch_encoder->slot_count(), 0);
+    for(int i = 0; i < message.size(); i++)
+    {
+        slots[i] = message[i];
+        slots[i + period] = message[i];
+    }
+    Plaintext plain;
+    batch_encoder->encode(slots, plain);
+    return plain;
+}
+
+/*
+Batch Decoder for the first length slots of a plaintext.
+*/
+std::vector<int> decode_vector_packed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const Plaintext &plain, 
+    unsigned length)
+{
+    std::vector<std::int64_t> slots;
+    batch_encoder->decode(plain, slots);
+    std::vector<int> message(length);
+    for(int i = 0; i < length; i++)
+        message[i] = static_cast<int>(slots[i]);
+    return message;
+}
+
+/*
+Batch Encoder for the generalized diagonals of an int matrix, as used by the Halevi-Shoup diagonal method. Diagonal j holds 
+matrix(i, (i+j) mod d) in slot i, where d = max(rows, cols). Entries outside of the matrix are zero.
+*/
+std::vector<Plaintext> encode_matrix_diagonals(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const Matrix<int> &message)
+{
+    const unsigned rows = message.get_rows();
+    const unsigned cols = message.get_cols();
+    const unsigned d = max(rows, cols);
+    const unsigned g = diagonal_baby_steps(d);
+    if (2 * d > batch_encoder->slot_count() / 2)
+        throw invalid_argument("matrix does not fit in a row of slots");
+    std::vector<Plaintext> diagonals(d);
+    for(int j = 0; j < d; j++)
+    {
+        const unsigned giant = j - j % g;
+        std::vector<std::int64_t> slots(batch_encoder->slot_count(), 0);
+        for(int i = 0; i < rows; i++)
+        {
+            unsigned col = (i + j) % d;
+            if (col < cols)
+                slots[i + giant] = message(i, col);
+        }
+        batch_encoder->encode(slots, diagonals[j]);
+    }
+    return diagonals;
+}
+
+/*
+Number of baby steps of the baby-step/giant-step diagonal method for d diagonals.
+*/
+unsigned diagonal_baby_steps(unsigned d)
+{
+    unsigned baby_steps = 1;
+    unsigned least_rotations = d;
+    for(unsigned g = 1; g <= d; g++)
+    {
+        unsigned rotations = (g - 1) + ((d + g - 1) / g - 1);
+        if (rotations <= least_rotations)
+        {
+            least_rotations = rotations;
+            baby_steps = g;
+        }
+    }
+    return baby_steps;
+}
+
+/*
+Rotation steps needed by the diagonal method for a rows x cols matrix.
+*/
+std::vector<int> diagonal_rotation_steps(unsigned rows, unsigned cols)
+{
+    const unsigned d = max(rows, cols);
+    const unsigned g = diagonal_baby_steps(d);
+    std::vector<int> steps;
+    for(int b = 1; b < g; b++)
+        steps.push_back(b);
+    for(int giant = g; giant < d; giant += g)
+        steps.push_back(giant);
+    return steps;
+}
+
+/*
+Galois elements that correspond to row rotations by the given steps, to generate only the Galois keys that are needed. 
+Same convention as SEAL: a left rotation by step is the automorphism x -> x^(3^step mod 2N).
+*/
+std::vector<std::uint64_t> galois_elts_from_steps(const std::vector<int> &steps, std::size_t poly_modulus_degree)
+{
+    const std::uint64_t m = 2 * poly_modulus_degree;
+    const int row_size = poly_modulus_degree / 2;
+    std::vector<std::uint64_t> galois_elts;
+    for(int i = 0; i < steps.size(); i++)
+    {
+        int pos_step = steps[i] < 0 ? row_size + steps[i] : steps[i];
+        std::uint64_t galois_elt = 1;
+        for(int s = 0; s < pos_step; s++)
+            galois_elt = (galois_elt * 3) & (m - 1);
+        if (find(galois_elts.begin(), galois_elts.end(), galois_elt) == galois_elts.end())
+            galois_elts.push_back(galois_elt);
+    }
+    return galois_elts;
+}
+
+/*
+Rotate the slots of a packed ciphertext in place: the rows of the BatchEncoder slots, or the vector of the CKKS slots.
+*/
+static void rotate_packed_inplace(const std::unique_ptr<seal::Evaluator> &evaluator, Ciphertext &encrypted, int steps, 
+    const GaloisKeys &galois_keys, bool ckks)
+{
+    if (ckks)
+        evaluator->rotate_vector_inplace(encrypted, steps, galois_keys);
+    else
+        evaluator->rotate_rows_inplace(encrypted, steps, galois_keys);
+    INSTRUMENT_COUNT(Counter::rotate, 1);
+}
+
+/*
+Baby-step/giant-step sum of the diagonal method, shared by the BFV and CKKS versions. rotations[b] holds the baby-step 
+rotation of encrypted by b, computed only if a nonzero diagonal needs it, and rotations[0] holds the products. The sum of 
+each giant step is accumulated in scratch and rotated by the giant step. If accumulate, the sums are added to result, 
+otherwise the first one overwrites it. Returns false if all diagonals are zero.
+*/
+static bool sum_diagonals(const std::unique_ptr<seal::Evaluator> &evaluator, const GaloisKeys &galois_keys, 
+    const std::vector<Plaintext> &diagonals, const Ciphertext &encrypted, Ciphertext &result, Ciphertext &scratch, 
+    std::vector<Ciphertext> &rotations, bool ckks, bool accumulate)
+{
+    const unsigned d = diagonals.size();
+    const unsigned g = diagonal_baby_steps(d);
+    rotations.resize(g);
+    for(unsigned b = 1; b < g; b++)
+    {
+        for(unsigned j = b; j < d; j += g)
+        {
+            if (!diagonals[j].is_zero())
+            {
+                rotations[b] = encrypted;
+                rotate_packed_inplace(evaluator, rotations[b], b, galois_keys, ckks);
+                break;
             }
+        }
+    }
+
+    bool written = false;
+    for(unsigned giant = 0; giant < d; giant += g)
+    {
+        bool empty = true;
+        for(unsigned b = 0; b < g && giant + b < d; b++)
+        {
+            const Plaintext &diagonal = diagonals[giant + b];
+            if (diagonal.is_zero())
+                continue;
+            const Ciphertext &rotated = b == 0 ? encrypted : rotations[b];
+            if (empty)
+                evaluator->multiply_plain(rotated, diagonal, scratch);
             else
             {
-                result[i] = temp[j];
+                evaluator->multiply_plain(rotated, diagonal, rotations[0]);
+                evaluator->add_inplace(scratch, rotations[0]);
+                INSTRUMENT_COUNT(Counter::add, 1);
             }
-            temp = encrypted;
+            INSTRUMENT_COUNT(Counter::multiply_plain, 1);
+            empty = false;
         }
+        if (empty)
+            continue;
+        if (giant > 0)
+            rotate_packed_inplace(evaluator, scratch, giant, galois_keys, ckks);
+        if (accumulate || written)
+        {
+            evaluator->add_inplace(result, scratch);
+            INSTRUMENT_COUNT(Counter::add, 1);
+        }
+        else
+            swap(result, scratch);
+        written = true;
     }
+    return written;
+}
+
+/*
+Multiply a plaintext matrix, given by its diagonals, by a packed ciphertext vector with the baby-step/giant-step diagonal 
+method. Pass an encryption of zero as the initial value of the result.
+*/
+Ciphertext mult_matrix_vector_diagonal(const std::unique_ptr<seal::Evaluator> &evaluator, const GaloisKeys &galois_keys, 
+    const std::vector<Plaintext> &diagonals, const Ciphertext &encrypted, Ciphertext result)
+{
+    Ciphertext scratch;
+    std::vector<Ciphertext> rotations;
+    mult_matrix_vector_diagonal(evaluator, galois_keys, diagonals, encrypted, result, scratch, rotations);
     return result;
 }
 
+/*
+Diagonal method in place: result holds an encryption of zero on entry and the product on exit.
+*/
+void mult_matrix_vector_diagonal(const std::unique_ptr<seal::Evaluator> &evaluator, const GaloisKeys &galois_keys, 
+    const std::vector<Plaintext> &diagonals, const Ciphertext &encrypted, Ciphertext &result, Ciphertext &scratch, 
+    std::vector<Ciphertext> &rotations)
+{
+    sum_diagonals(evaluator, galois_keys, diagonals, encrypted, result, scratch, rotations, false, true);
+}
+
+/*
+Batch Encoder for the states of a fleet of plants, multiplexed over the slots.
+*/
+void encode_vector_multiplexed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, 
+    const std::vector<std::vector<int>> &messages, std::vector<Plaintext> &plain)
+{
+    if (messages.empty() || messages.size() > batch_encoder->slot_count())
+        throw invalid_argument("number of plants does not fit in the slots");
+    const unsigned length = messages[0].size();
+    std::vector<std::int64_t> slots(batch_encoder->slot_count(), 0);
+    plain.resize(length);
+    for(int i = 0; i < length; i++)
+    {
+        for(int j = 0; j < messages.size(); j++)
+            slots[j] = messages[j][i];
+        batch_encoder->encode(slots, plain[i]);
+    }
+}
+
+/*
+Batch Decoder for the messages of a fleet of plants.
+*/
+void decode_vector_multiplexed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const std::vector<Plaintext> &plain, 
+    unsigned num_plants, std::vector<std::vector<int>> &messages)
+{
+    std::vector<std::int64_t> slots;
+    messages.resize(num_plants);
+    for(int j = 0; j < num_plants; j++)
+        messages[j].resize(plain.size());
+    for(int i = 0; i < plain.size(); i++)
+    {
+        batch_encoder->decode(plain[i], slots);
+        for(int j = 0; j < num_plants; j++)
+            messages[j][i] = static_cast<int>(slots[j]);
+    }
+}
+
+/*
+Batch Encoder for an int matrix that is shared by all plants of a fleet.
+*/
+Matrix<Plaintext> encode_matrix_multiplexed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const Matrix<int> &message)
+{
+    Matrix<Plaintext> plain(message.get_rows(), message.get_cols(), Plaintext());
+    for(int i = 0; i < message.get_rows(); i++)
+        for(int j = 0; j < message.get_cols(); j++)
+            batch_encoder->encode(std::vector<std::int64_t>(batch_encoder->slot_count(), message(i,j)), plain(i,j));
+    return plain;
+}
+
+/*
+CKKS Encoder for a vector of real messages, packed as for the diagonal method.
+*/
+Plaintext encode_vector_packed(const std::unique_ptr<seal::CKKSEncoder> &ckks_encoder, const std::vector<double> &message, 
+    unsigned period, double scale)
+{
+    if (message.size() > period || 2 * period > ckks_encoder->slot_count())
+        throw invalid_argument("message does not fit in the slots");
+    std::vector<double> slots(ckks_encoder->slot_count(), 0);
+    for(int i = 0; i < message.size(); i++)
+    {
+        slots[i] = message[i];
+        slots[i + period] = message[i];
+    }
+    Plaintext plain;
+    ckks_encoder->encode(slots, scale, plain);
+    return plain;
+}
+
+/*
+CKKS Decoder for the first length slots of a plaintext.
+*/
+std::vector<double> decode_vector_packed(const std::unique_ptr<seal::CKKSEncoder> &ckks_encoder, const Plaintext &plain, 
+    unsigned length)
+{
+    std::vector<double> slots;
+    ckks_encoder->decode(plain, slots);
+    slots.resize(length);
+    return slots;
+}
+
+/*
+CKKS Encoder for the generalized diagonals of a real matrix.
+*/
+std::vector<Plaintext> encode_matrix_diagonals(const std::unique_ptr<seal::CKKSEncoder> &ckks_encoder, 
+    const Matrix<double> &message, double scale)
+{
+    const unsigned rows = message.get_rows();
+    const unsigned cols = message.get_cols();
+    const unsigned d = max(rows, cols);
+    const unsigned g = diagonal_baby_steps(d);
+    if (2 * d > ckks_encoder->slot_count())
+        throw invalid_argument("matrix does not fit in the slots");
+    std::vector<Plaintext> diagonals(d);
+    for(int j = 0; j < d; j++)
+    {
+        const unsigned giant = j - j % g;
+        std::vector<double> slots(ckks_encoder->slot_count(), 0);
+        for(int i = 0; i < rows; i++)
+        {
+            unsigned col = (i + j) % d;
+            if (col < cols)
+                slots[i + giant] = message(i, col);
+        }
+        ckks_encoder->encode(slots, scale, diagonals[j]);
+    }
+    return diagonals;
+}
+
+/*
+Diagonal method for CKKS, with a rescale of the result.
+*/
+void mult_matrix_vector_diagonal_ckks(const std::unique_ptr<seal::Evaluator> &evaluator, const GaloisKeys &galois_keys, 
+    const std::vector<Plaintext> &diagonals, const Ciphertext &encrypted, Ciphertext &result, Ciphertext &scratch, 
+    std::vector<Ciphertext> &rotations)
+{
+    if (!sum_diagonals(evaluator, galois_keys, diagonals, encrypted, result, scratch, rotations, true, false))
+        throw invalid_argument("all diagonals are zero");
+    evaluator->rescale_to_next_inplace(result);
+}
+
 /*
 Print the noise budget for an encrypted vector.
 */
-void print_noise_budget_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> encrypted)
+void print_noise_budget_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> &encrypted)
 {
     for(int i = 0; i < encrypted.size(); i++)
         cout << decryptor->invariant_noise_budget(encrypted[i]) << " bits; ";
     cout << endl;
 }
 
+/*
+Noise budget for an encrypted vector.
+*/
+void noise_budget_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> &encrypted, 
+    std::vector<int> &budgets)
+{
+    budgets.resize(encrypted.size());
+    for(int i = 0; i < encrypted.size(); i++)
+        budgets[i] = decryptor->invariant_noise_budget(encrypted[i]);
+}
+
 /*
 Helper function: Prints the `parms_id' to std::ostream.
 */
@@ -239,4 +1295,44 @@ void setup_params(EncryptionParameters &parms)
     Set the plaintext modulus, which also affects the noise budget.
     */
     parms.set_plain_modulus(1 << 6);    // 2^6 = 64 bits
+}
+
+/*
+Setup the encryption scheme and parameters for the packed (batching) mode.
+*/
+void setup_params_batching(EncryptionParameters &parms)
+{
+    /*
+    Set the degree of the polynomial modulus, which has to be a large power of 2.
+    */
+    int poly_modulus_deg_value = 4096;
+    parms.set_poly_modulus_degree(poly_modulus_deg_value);
+
+    /*
+    Set the ciphertext coefficient modulus, which substantially affects the noise budget.
+    */
+    parms.set_coeff_modulus(coeff_modulus_128(poly_modulus_deg_value));
+
+    /*
+    Batching needs a prime plaintext modulus congruent to 1 modulo 2*poly_modulus_degree.
+    */
+    parms.set_plain_modulus(40961);
+}
+
+/*
+Setup the encryption scheme and parameters for the real-valued (CKKS) mode.
+*/
+void setup_params_ckks(EncryptionParameters &parms)
+{
+    /*
+    Set the degree of the polynomial modulus, which has to be a large power of 2. There are poly_modulus_degree/2 slots.
+    */
+    int poly_modulus_deg_value = 4096;
+    parms.set_poly_modulus_degree(poly_modulus_deg_value);
+
+    /*
+    Set the ciphertext coefficient modulus: K*x is rescaled once, by the last (40-bit) prime, and the 60-bit prime that is 
+    left holds the result at the scale ckks_scale = 2^40 with 20 bits for the integer part.
+    */
+    parms.set_coeff_modulus({small_mods_60bit(0), small_mods_40bit(0)});
 }
\ No newline at end of file
@@ -12,9 +12,15 @@
 #include <mutex>
 #include <memory>
 #include <limits>
+#include <algorithm>
+#include <cmath>
 
 #include "seal/seal.h"
 #include "Matrix.h"
+#include "SparseMatrix.h"
+#include "ThreadPool.h"
+#include "Instrumentation.h"
+#include "Logger.h"
 
 using namespace std;
 using namespace seal;
@@ -22,55 +28,312 @@ using namespace seal;
 /*
 Print a vector object.
 */
-void print_vector(const std::vector<int> v);
+void print_vector(const std::vector<int> &v);
+void print_vector(const std::vector<double> &v);
 
 /*
 Integer Encoder for a vector of int messages.
 */
-std::vector<Plaintext> encode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<int> message);
+std::vector<Plaintext> encode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<int> &message);
+
+/*
+Integer Encoder for a vector of int messages into a caller-owned buffer, which is reused across calls.
+*/
+void encode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<int> &message, std::vector<Plaintext> &plain);
 
 /*
 Integer Encoder for a matrix of int messages.
 */
-Matrix<Plaintext> encode_matrix(const std::unique_ptr<seal::IntegerEncoder> &encoder, const Matrix<int> message);
+Matrix<Plaintext> encode_matrix(const std::unique_ptr<seal::IntegerEncoder> &encoder, const Matrix<int> &message);
 
 /*
 Integer Decoder for a vector of plaintexts.
 */
-std::vector<int> decode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<Plaintext> plain);
+std::vector<int> decode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<Plaintext> &plain);
+
+/*
+Integer Decoder for a vector of plaintexts into a caller-owned buffer.
+*/
+void decode_vector(const std::unique_ptr<seal::IntegerEncoder> &encoder, const std::vector<Plaintext> &plain, std::vector<int> &message);
 
 /*
 Encrypt a vector of plaintexts.
 */
-std::vector<Ciphertext> encrypt_vector(const std::unique_ptr<seal::Encryptor> &encryptor, const std::vector<Plaintext> plain);
+std::vector<Ciphertext> encrypt_vector(const std::unique_ptr<seal::Encryptor> &encryptor, const std::vector<Plaintext> &plain);
+
+/*
+Encrypt a vector of plaintexts into a caller-owned buffer. The ciphertexts keep their allocation from the previous call.
+*/
+void encrypt_vector(const std::unique_ptr<seal::Encryptor> &encryptor, const std::vector<Plaintext> &plain, 
+    std::vector<Ciphertext> &encrypted);
 
 /*
 Encrypt a matrix of plaintexts.
 */
-Matrix<Ciphertext> encrypt_matrix(const std::unique_ptr<seal::Encryptor> &encryptor, const Matrix<Plaintext> plain);
+Matrix<Ciphertext> encrypt_matrix(const std::unique_ptr<seal::Encryptor> &encryptor, const Matrix<Plaintext> &plain);
 
 /*
 Decrypt a vector of ciphertexts.
 */
-std::vector<Plaintext> decrypt_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> encrypted);
+std::vector<Plaintext> decrypt_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> &encrypted);
+
+/*
+Decrypt a vector of ciphertexts into a caller-owned buffer.
+*/
+void decrypt_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> &encrypted, 
+    std::vector<Plaintext> &plain);
 
 /*
 Decrypt a matrix of ciphertexts.
 */
-Matrix<Plaintext> decrypt_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const Matrix<Ciphertext> encrypted);
+Matrix<Plaintext> decrypt_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const Matrix<Ciphertext> &encrypted);
+
+/*
+Stacked gain of a horizon of time steps, [K; K(A+BK); ...; K(A+BK)^(horizon-1)], which maps x[k] to the control inputs 
+u[k], ..., u[k+horizon-1] of the closed loop x[k+1] = (A+BK)x[k]. Throws invalid_argument if an entry exceeds the range of 
+int.
+*/
+Matrix<int> stack_horizon_gain(const Matrix<int> &K, const Matrix<int> &A, const Matrix<int> &B, unsigned horizon);
 
 /*
 Multiply a plaintext matrix by a plaintext vector. Pass a vector of encrypted zeros of appropiate size such that we don't need 
 to pass encoder and encryptor. SEAL does not allow multiplication by zero plaintexts, so we have to perform a separate check 
 for that.
 */
-std::vector<Ciphertext> mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> plain_matrix, 
-	const std::vector<Ciphertext> encrypted, std::vector<Ciphertext> result);
+std::vector<Ciphertext> mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &plain_matrix, 
+	const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> result);
+
+/*
+Multiply a plaintext matrix by a ciphertext vector in place: result holds the encrypted zeros on entry and the product on 
+exit. Each product is written to the scratch ciphertext with an out-of-place multiplication, so that neither the input nor 
+the result is copied. Reusing result and scratch across time steps avoids allocations in the control loop.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &plain_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, Ciphertext &scratch);
+
+/*
+Multiply a ciphertext matrix by a ciphertext vector.
+*/
+std::vector<Ciphertext> mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted);
+
+/*
+Multiply a ciphertext matrix by a ciphertext vector into a caller-owned result, using a scratch ciphertext for the products.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, Ciphertext &scratch);
+
+/*
+Multiply a plaintext matrix by a ciphertext vector on a thread pool, in place as above. The rows are split across the 
+workers; if there are fewer rows than workers, the products are computed in parallel and each row is summed with a tree 
+reduction instead. Each worker allocates from its own memory pool.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &plain_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, ThreadPool &thread_pool);
+
+/*
+Multiply a ciphertext matrix by a ciphertext vector on a thread pool into a caller-owned result, as above.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, ThreadPool &thread_pool);
+
+/*
+Relinearize each ciphertext of a vector in place back to size 2. Called once per output row after the accumulation of the 
+products (lazy relinearization), rather than after each product.
+*/
+void relinearize_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const RelinKeys &relin_keys, 
+    std::vector<Ciphertext> &encrypted);
+
+/*
+Relinearize each ciphertext of a vector in place on a thread pool, one row per task.
+*/
+void relinearize_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const RelinKeys &relin_keys, 
+    std::vector<Ciphertext> &encrypted, ThreadPool &thread_pool);
+
+/*
+Switch each ciphertext of a vector in place down to the level of the given parms_id, e.g., the last one of the modulus 
+chain, which shrinks the ciphertexts and makes their decryption cheaper. Ciphertexts already at that level are left as is.
+*/
+void mod_switch_vector(const std::unique_ptr<seal::Evaluator> &evaluator, std::vector<Ciphertext> &encrypted, 
+    parms_id_type parms_id);
+
+/*
+Transform a plaintext matrix to NTT form, such that its products with ciphertexts in NTT form need no transforms.
+*/
+void transform_to_ntt_matrix(const std::unique_ptr<seal::Evaluator> &evaluator, Matrix<Plaintext> &plain_matrix, 
+    parms_id_type parms_id);
+
+/*
+Multiply a plaintext matrix in NTT form by a ciphertext vector, adding the product to result, which holds the encrypted zeros 
+on entry. The n inputs are transformed to NTT form once into the encrypted_ntt buffer, each row is accumulated in NTT form, 
+and each of the m sums is transformed back once, i.e., O(m+n) transforms instead of O(m*n).
+*/
+void mult_matrix_vector_ntt(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &ntt_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &encrypted_ntt, std::vector<Ciphertext> &result, 
+    Ciphertext &accumulator, Ciphertext &scratch);
+
+/*
+Multiply a plaintext matrix in NTT form by a ciphertext vector on a thread pool, as above: the forward transforms and the 
+rows are split across the workers.
+*/
+void mult_matrix_vector_ntt(const std::unique_ptr<seal::Evaluator> &evaluator, const Matrix<Plaintext> &ntt_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &encrypted_ntt, std::vector<Ciphertext> &result, 
+    ThreadPool &thread_pool);
+
+/*
+Multiply a sparse plaintext matrix by a ciphertext vector in place, as above, with one product per nonzero.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Plaintext> &plain_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, Ciphertext &scratch);
+
+/*
+Multiply a sparse ciphertext matrix by a ciphertext vector into a caller-owned result, with one product per nonzero. The 
+entries of the result for the rows without nonzeros are left as they are, so the caller seeds them with encryptions of zero 
+if there are any.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, Ciphertext &scratch);
+
+/*
+Multiply a sparse plaintext or ciphertext matrix by a ciphertext vector on a thread pool, as above. The rows are split across 
+the workers; if there are fewer rows than workers, the products of the nonzeros are computed in parallel and each row is 
+summed with a tree reduction instead.
+*/
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Plaintext> &plain_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, ThreadPool &thread_pool);
+void mult_matrix_vector(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Ciphertext> &enc_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &result, ThreadPool &thread_pool);
+
+/*
+Transform the nonzeros of a sparse plaintext matrix to NTT form.
+*/
+void transform_to_ntt_matrix(const std::unique_ptr<seal::Evaluator> &evaluator, SparseMatrix<Plaintext> &plain_matrix, 
+    parms_id_type parms_id);
+
+/*
+Multiply a sparse plaintext matrix in NTT form by a ciphertext vector, as above: only the inputs in the columns with nonzeros 
+are transformed to NTT form, and only the rows with nonzeros are transformed back.
+*/
+void mult_matrix_vector_ntt(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Plaintext> &ntt_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &encrypted_ntt, std::vector<Ciphertext> &result, 
+    Ciphertext &accumulator, Ciphertext &scratch);
+void mult_matrix_vector_ntt(const std::unique_ptr<seal::Evaluator> &evaluator, const SparseMatrix<Plaintext> &ntt_matrix, 
+    const std::vector<Ciphertext> &encrypted, std::vector<Ciphertext> &encrypted_ntt, std::vector<Ciphertext> &result, 
+    ThreadPool &thread_pool);
+
+/*
+Batch Encoder for a vector of int messages. The message is zero-padded to the given period and written twice in a row of 
+slots, so that row rotations by up to period-1 steps still read the right entries (needed by the diagonal method).
+*/
+Plaintext encode_vector_packed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const std::vector<int> &message, 
+    unsigned period);
+
+/*
+Batch Decoder for the first length slots of a plaintext.
+*/
+std::vector<int> decode_vector_packed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const Plaintext &plain, 
+    unsigned length);
+
+/*
+Number of baby steps g of the baby-step/giant-step diagonal method for d diagonals: diagonal j = g*a + b is reached by a 
+baby step of b and a giant step of g*a. g minimizes the number of rotations (g-1) + (ceil(d/g)-1), which is also the number 
+of Galois keys, i.e., about 2*sqrt(d) instead of d-1. Ties go to the larger g, so small matrices keep the plain diagonal 
+method (g = d).
+*/
+unsigned diagonal_baby_steps(unsigned d);
+
+/*
+Batch Encoder for the generalized diagonals of an int matrix, as used by the Halevi-Shoup diagonal method. Diagonal j holds 
+matrix(i, (i+j) mod d) in slot i, where d = max(rows, cols). Entries outside of the matrix are zero. For the baby-step/giant-step 
+schedule, diagonal j = g*a + b is stored rotated right by its giant step g*a, i.e., from slot g*a on.
+*/
+std::vector<Plaintext> encode_matrix_diagonals(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const Matrix<int> &message);
+
+/*
+Rotation steps needed by the diagonal method for a rows x cols matrix: the baby steps 1, ..., g-1 and the giant steps g, 2g, ...
+*/
+std::vector<int> diagonal_rotation_steps(unsigned rows, unsigned cols);
+
+/*
+Galois elements that correspond to row rotations by the given steps, to generate only the Galois keys that are needed.
+*/
+std::vector<std::uint64_t> galois_elts_from_steps(const std::vector<int> &steps, std::size_t poly_modulus_degree);
+
+/*
+Multiply a plaintext matrix, given by its diagonals, by a packed ciphertext vector with the baby-step/giant-step diagonal 
+method: result = sum_a rot(sum_b diag_{g*a+b} * rot(encrypted, b), g*a). The baby-step rotations of encrypted are computed 
+once and shared by all giant steps, so the product costs (g-1) + (ceil(d/g)-1) rotations instead of d-1. Pass an encryption 
+of zero as the initial value of the result. Zero diagonals are skipped, and so are the rotations that only they need.
+*/
+Ciphertext mult_matrix_vector_diagonal(const std::unique_ptr<seal::Evaluator> &evaluator, const GaloisKeys &galois_keys, 
+    const std::vector<Plaintext> &diagonals, const Ciphertext &encrypted, Ciphertext result);
+
+/*
+Diagonal method in place: result holds an encryption of zero on entry and the product on exit, the sum of a giant step is 
+written to the scratch ciphertext and the baby-step rotations to the rotations buffer, which is reused across calls.
+*/
+void mult_matrix_vector_diagonal(const std::unique_ptr<seal::Evaluator> &evaluator, const GaloisKeys &galois_keys, 
+    const std::vector<Plaintext> &diagonals, const Ciphertext &encrypted, Ciphertext &result, Ciphertext &scratch, 
+    std::vector<Ciphertext> &rotations);
+
+/*
+Batch Encoder for the states of a fleet of plants, multiplexed over the slots: slot j of plaintext i holds entry i of the 
+message of plant j. All messages have the same length, and there are at most slot_count plants. Then a plaintext matrix 
+with entries that are constant over the slots multiplies the messages of all plants in one pass of mult_matrix_vector.
+*/
+void encode_vector_multiplexed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, 
+    const std::vector<std::vector<int>> &messages, std::vector<Plaintext> &plain);
+
+/*
+Batch Decoder for the messages of the first num_plants plants, multiplexed over the slots as above.
+*/
+void decode_vector_multiplexed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const std::vector<Plaintext> &plain, 
+    unsigned num_plants, std::vector<std::vector<int>> &messages);
+
+/*
+Batch Encoder for an int matrix that is shared by all plants of a fleet: each entry is written to all slots.
+*/
+Matrix<Plaintext> encode_matrix_multiplexed(const std::unique_ptr<seal::BatchEncoder> &batch_encoder, const Matrix<int> &message);
+
+/*
+CKKS Encoder for a vector of real messages at the given scale, laid out as encode_vector_packed: zero-padded to the period 
+and written twice, so that vector rotations by up to period-1 steps still read the right entries.
+*/
+Plaintext encode_vector_packed(const std::unique_ptr<seal::CKKSEncoder> &ckks_encoder, const std::vector<double> &message, 
+    unsigned period, double scale);
+
+/*
+CKKS Decoder for the first length slots of a plaintext.
+*/
+std::vector<double> decode_vector_packed(const std::unique_ptr<seal::CKKSEncoder> &ckks_encoder, const Plaintext &plain, 
+    unsigned length);
+
+/*
+CKKS Encoder for the generalized diagonals of a real matrix, as encode_matrix_diagonals, at the given scale.
+*/
+std::vector<Plaintext> encode_matrix_diagonals(const std::unique_ptr<seal::CKKSEncoder> &ckks_encoder, 
+    const Matrix<double> &message, double scale);
+
+/*
+Diagonal method for CKKS, with the baby-step/giant-step schedule of mult_matrix_vector_diagonal and vector rotations, 
+followed by one rescale to the next level. The result is overwritten, since an encryption of zero at the scale of the 
+products is not available. With the diagonals encoded at the scale of the last prime of the coefficient modulus, the 
+rescaled result has the scale of the encrypted vector. Zero diagonals are skipped; at least one diagonal must be nonzero.
+*/
+void mult_matrix_vector_diagonal_ckks(const std::unique_ptr<seal::Evaluator> &evaluator, const GaloisKeys &galois_keys, 
+    const std::vector<Plaintext> &diagonals, const Ciphertext &encrypted, Ciphertext &result, Ciphertext &scratch, 
+    std::vector<Ciphertext> &rotations);
 
 /*
 Print the noise budget for an encrypted vector.
 */
-void print_noise_budget_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> encrypted);
+void print_noise_budget_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> &encrypted);
+
+/*
+Noise budget for an encrypted vector, in the given buffer, e.g., for a log record.
+*/
+void noise_budget_vector(const std::unique_ptr<seal::Decryptor> &decryptor, const std::vector<Ciphertext> &encrypted, 
+    std::vector<int> &budgets);
 
 /*
 Helper function: Prints the `parms_id' to std::ostream.
@@ -87,6 +350,26 @@ Setup the encryption scheme and parameters.
 */
 void setup_params(EncryptionParameters &parms);
 
+/*
+Setup the encryption scheme and parameters for the packed (batching) mode.
+*/
+void setup_params_batching(EncryptionParameters &parms);
+
+/*
+Setup the encryption scheme and parameters for the real-valued (CKKS) mode.
+*/
+void setup_params_ckks(EncryptionParameters &parms);
+
+/*
+Scale of the encoded real values in the CKKS mode.
+*/
+const double ckks_scale = static_cast<double>(1ULL << 40);
+
+/*
+Decomposition bit count used when generating Galois keys.
+*/
+const int decomposition_bit_count = 60;
+
 #include "helper.cpp"
 
 #endif
\ No newline at end of file